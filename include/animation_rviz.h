@@ -13,6 +13,9 @@
 #include <eigen_conversions/eigen_msg.h>
 #include <string.h>
 
+#include "drone_registry.h"
+#include "formation_spec.h"
+
 namespace rosdrone_Animation
 {
 
@@ -46,8 +49,8 @@ namespace rosdrone_Animation
       // private structures
       struct MsgEstimatedDronePosition
       {
-        std::string drone_name;
-        std::string target_name;
+        int drone;
+        int target;
         Eigen::Vector3d bearing;
         double distance;
       };
@@ -57,6 +60,7 @@ namespace rosdrone_Animation
         Eigen::Vector3d p;
         Eigen::Quaterniond q;
         Eigen::Matrix3d R;
+        bool valid = false;
       };
 
       struct TwistStructure
@@ -76,11 +80,13 @@ namespace rosdrone_Animation
       // private variables
       std::vector<MsgEstimatedDronePosition> vectorMeasures;
       visualization_msgs::MarkerArray markers;
-      std::map<int, TwistStructure> twists;
+      rosdrone::droneRegistry registry;
+      std::vector<std::string> frames;
+      std::vector<TwistStructure> twists;
       float dist_arrow_to_drone = 0.25;
       float length_arrow_percentage = 0.45;
-      std::map<int, std::map<int, Eigen::Vector3d>> relativeBearingDesired;
-      std::map<int, PoseStructure> posesGazebo;
+      rosdrone::bearingGraph desiredGraph;
+      std::vector<PoseStructure, Eigen::aligned_allocator<PoseStructure>> posesGazebo;
   };
 }
 #endif // ANIMATION_RVIZ_H
@@ -0,0 +1,77 @@
+#ifndef ARUCO_AGGREGATOR_H
+#define ARUCO_AGGREGATOR_H
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Eigen>
+#include <string>
+#include <vector>
+
+#include <fiducial_msgs/FiducialTransformArray.h>
+#include <drones/Formation.h>
+#include <drones/FormationLink.h>
+
+#include "drone_registry.h"
+#include "formation_buffer.h"
+
+namespace rosdrone_Detector
+{
+
+// Turns the fiducial transforms seen by any number of drones into one
+// Formation. Arrays are grouped by camera timestamp: a set is published as
+// soon as every observer sent an array of the same capture time (within
+// ~slop), when an array of a later capture time arrives, or when the window
+// opened by the first array of the set closes.
+class arucoAggregator
+{
+  public:
+    arucoAggregator(const ros::NodeHandle& ng, const ros::NodeHandle& nl);
+
+  private:
+    void getParametersROS();
+    void measureCallback(const fiducial_msgs::FiducialTransformArray::ConstPtr& msg, int observer);
+    void windowCallback(const ros::TimerEvent& event);
+    void fillLink(const fiducial_msgs::FiducialTransformArray& measures, drones::FormationLink& link);
+    void publishFormation();
+
+    // ROS Communication
+    ros::NodeHandle nhg, nhl;
+    ros::Publisher formationPub;
+    std::vector<ros::Subscriber> measureSubs;
+    ros::Timer windowTimer;
+
+    // drones of the formation, observers and targets alike
+    std::vector<int> ids;
+    std::vector<std::string> names;
+    std::vector<std::string> topics;
+
+    // target drone index of each fiducial id, -1 if unknown
+    std::vector<int> tagOwner;
+
+    // one slot per observer, allocated once
+    struct Slot
+    {
+      fiducial_msgs::FiducialTransformArray::ConstPtr measures;
+      bool fresh = false;
+    };
+    std::vector<Slot> slots;
+    int fresh = 0;
+    ros::Time setStamp;
+    double slop = 0.01;
+    double window = 0.05;
+
+    // largest fiducial of each target in the current array
+    std::vector<int> bestTransform;
+    std::vector<double> bestArea;
+
+    // geometry of the camera and of the tags
+    Eigen::Matrix3d R_camera2drone;
+    Eigen::Vector3d t_camera2drone;
+    Eigen::Vector3d t_target2baseLink;
+
+    formationBuffer outputMessage;
+};
+
+}
+
+#endif // ARUCO_AGGREGATOR_H
@@ -8,109 +8,154 @@
 #include <eigen_conversions/eigen_msg.h>
 #include <string.h>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <opencv2/highgui/highgui.hpp>
-#include <opencv2/video/tracking.hpp>
 #include <cv_bridge/cv_bridge.h>
 
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <image_transport/image_transport.h>
+#include "color_lut.h"
+#include "blob_extractor.h"
+#include "spsc_queue.h"
+#include "parallel_loop.h"
+#include "kalman_filter_bank.h"
+#include "stage_profiler.h"
+#include "bearing_table.h"
 #include <drones/Formation.h>
 #include <drones/FormationLink.h>
 #include <std_msgs/Float64.h>
+#include <std_msgs/UInt8.h>
 #include <geometry_msgs/Vector3.h>
 
 namespace rosdrone_Detector
 {
 
-struct KalmanFilter
+// image position and radius of a target, with velocity of the position
+typedef kalmanFilterBank<5, 3> TargetFilterBank;
+
+// camera encodings segmented as they are, without conversion to bgr8
+enum Ingest
 {
-  KalmanFilter(int stateSize, int measSize)
-    : kf(stateSize, measSize, 0, CV_32F),
-      state(stateSize, 1, CV_32F),
-      meas(measSize, 1, CV_32F)
-  {
-    // cv::Mat procNoise(stateSize, 1, type)
-
-    cv::setIdentity(kf.transitionMatrix);
-
-    kf.measurementMatrix = cv::Mat::zeros(measSize, stateSize, CV_32F);
-    kf.measurementMatrix.at<float>(0) = 1.0f;
-    kf.measurementMatrix.at<float>(6) = 1.0f;
-    kf.measurementMatrix.at<float>(12) = 1.0f;
-
-    kf.processNoiseCov = cv::Mat::zeros(stateSize, stateSize, CV_32F);
-    kf.processNoiseCov.at<float>(0) = 1e-4;
-    kf.processNoiseCov.at<float>(6) = 1e-4;
-    kf.processNoiseCov.at<float>(12) = 1e-4;
-    kf.processNoiseCov.at<float>(18) = 1e-4;
-    kf.processNoiseCov.at<float>(24) = 1e-4;
-
-    kf.measurementNoiseCov = cv::Mat::zeros(measSize, measSize, CV_32F);
-    kf.measurementNoiseCov.at<float>(0) = 1e-4;
-    kf.measurementNoiseCov.at<float>(4) = 1e-4;
-    kf.measurementNoiseCov.at<float>(8) = 5e-3;
-  }
-  KalmanFilter() : KalmanFilter(5,3) {}
-
-  cv::KalmanFilter kf;
-  cv::Mat state;
-  cv::Mat meas;
-  double last_estimation = ros::Time::now().toSec();
-  double current_estimation = ros::Time::now().toSec();
-  double last_measure = 0;
-
-  bool found = false;
+  INGEST_BGR, INGEST_YUYV, INGEST_UYVY, INGEST_NV12, INGEST_NV21,
+  INGEST_BAYER_RGGB, INGEST_BAYER_GRBG, INGEST_BAYER_GBRG, INGEST_BAYER_BGGR
+};
 
+// quality given up, in this order, to stay within the frame budget
+enum Degradation
+{
+  DEGRADE_NONE,
+  DEGRADE_NO_BLUR,           // colors classified without the gaussian blur
+  DEGRADE_NARROW_ROI,        // smaller search windows around tracked targets
+  DEGRADE_HALF_RESOLUTION,   // lost targets searched at half resolution first
+  DEGRADE_SKIP_SEARCH,       // lost targets searched every other frame only
+  DEGRADE_LEVELS
 };
 
-typedef std::shared_ptr<KalmanFilter> KalmanFilterPtr;
+// detection options, read from the private namespace of the node
+struct DetectorOptions
+{
+  bool single_pass = true;
+  bool color_lut = true;
+  bool roi_tracking = true;
+  double roi_scale = 2.0;
+  bool pipeline = false;
+  bool blob_extractor = true;
+  int pyramid_levels = 0;
+  double debug_image_scale = 1.0;
+  bool native_ingest = true;
+  double frame_budget = 0;  // seconds per frame, 0 for full quality always
+};
 
 class ballDetector
 {
   public:
-    ballDetector(const ros::NodeHandle& ng, const ros::NodeHandle& nl);
+    ballDetector(const ros::NodeHandle& nhg, const ros::NodeHandle& nhl);
+    // offline detector without ROS communications (benchmarks)
+    ballDetector(int drone_ID, const std::map<int, std::vector<int>>& drones_color,
+                 const DetectorOptions& options = DetectorOptions());
+    ~ballDetector();
 
     void spinDetector();
+    void setProfiler(stageProfiler* _profiler) { profiler = _profiler; }
+    const drones::FormationLink& lastBearings() const { return outputMessage; }
+    int degradationLevel() const { return frameBudget.level; }
+
+    // callback functions
+    void camInfoCallback(const sensor_msgs::CameraInfo& camInfo);
+    void imageCallback(const sensor_msgs::ImageConstPtr& image);
 
   private:
     // private functions
-    void getParametersROS();
-    void colorRGB2HUE(int r, int g, int b);
+    void initialize(const DetectorOptions& options);
+    void getParametersROS(const ros::NodeHandle& nhg, const ros::NodeHandle& nhl);
+    int colorRGB2HUE(int r, int g, int b);
     void imgBGRtoimgHUE(cv::Mat& img);
     bool detectColorfulCirclesHUE(cv::Mat& img, cv::Vec3f& circle, bool write_circle = false);
     bool bestRadiusEstimation(double& radius, const cv::Mat& image, const cv::Vec3f& circle);
 
     std::vector<cv::Point> findMainContour(const cv::Mat &_im);
+    std::vector<cv::Point> findMainContourInMask(cv::Mat& mask);
     bool process(const cv::Mat &_im, cv::Vec3f& circle, bool write_output = false);
+    bool processMask(cv::Mat& mask, const int& k, cv::Vec3f& circle, float min_radius = 10.0);
+    bool circleFromBlobs(const std::vector<Blob>& blobs, cv::Vec3f& circle, float min_radius = 10.0);
+    bool circleFromContour(const std::vector<cv::Point>& contour, cv::Vec3f& circle, float min_radius = 10.0);
+
+    void setTargetsHueTable();
+    void segmentTargets(const cv::Mat& _im, Ingest ingest = INGEST_BGR, const cv::Mat& chroma = cv::Mat());
+    cv::Mat segmentWindow(const cv::Mat& _im, int k, Ingest ingest = INGEST_BGR, const cv::Mat& chroma = cv::Mat());
+    void classifyTargets(const cv::Mat& _im, Ingest ingest, const cv::Mat& chroma, bool window,
+                         cv::Mat& labels, std::vector<cv::Mat>& masks);
+    static cv::Mat grownView(cv::Mat& buffer, cv::Size size, int type);
+    Ingest ingestOf(const std::string& encoding) const;
+    bool detectTarget(const cv::Mat& _im, const int& k, cv::Vec3f& circle, bool segment = true);
+    // search window of a tracked target, only that target is segmented
+    bool detectInWindow(const cv::Mat& _im, const int& k, cv::Vec3f& circle);
+
+    bool predictSearchWindow(const int& k, const double& stamp, cv::Rect& window);
+    bool insideWindow(const cv::Vec3f& circle, const cv::Rect& window);
+    void searchPyramid(std::vector<bool>& measures, std::vector<cv::Vec3f>& circles, int levels);
+    void updateFrameBudget(double seconds);
 
     void kalmanFilterProcess(const bool measure,
                              cv::Vec3f& circle,
-                             const int& uav_detected_id);
-    bool getKalmanFilterStructure(KalmanFilterPtr& KFPtr,
-                                  const bool measure,
-                                  const int& uav_detected_id);
-
-    bool addMeasureToOutput(const int& target_id, const cv::Vec3f& circle);
-
-    // callback functions
-    void camInfoCallback(const sensor_msgs::CameraInfo& camInfo);
-    void imageCallback(const sensor_msgs::ImageConstPtr& image);
+                             const int& k,
+                             const double& stamp);
+    double frameTime(const std_msgs::Header& header);
+
+    struct CameraModel;
+    bool addMeasureToOutput(const CameraModel& camera, const int& target_id, const cv::Vec3f& circle);
+    void queueDebugImage(const cv_bridge::CvImageConstPtr& image, std::vector<cv::Vec3f>& circles);
+    void publishDebugImage(const cv::Mat& bgr, const std::vector<cv::Vec3f>& circles,
+                           const std_msgs::Header& header);
+
+    // pipeline stages, decoding runs in imageCallback and
+    // the publish stage (debug image) runs in every mode
+    void startPipeline();
+    void segmentStage();
+    void contourStage();
+    void publishStage();
 
     // ROS Communication
-    ros::NodeHandle nhg, nhl;
-    ros::Publisher imagePub, bearingPub;
+    ros::Publisher bearingPub, degradationPub;
+    image_transport::Publisher imagePub;
     ros::Subscriber camInfoSub, posesSub;
     image_transport::Subscriber imageSub;
 
     // private structures
-    struct CamInfo
+    // Never modified once published: camInfoCallback builds a new model when
+    // the camera changes and swaps it in atomically, each frame works on one
+    // snapshot (the pipeline reads it on the contour thread).
+    struct CameraModel
     {
       Eigen::Matrix3d K;
       Eigen::Matrix3d R;
       double width, height;
-      bool received = false;
-    } camInfo;
+      bearingTable rays; // undistorted pixel rays in the body frame
+    };
+    std::shared_ptr<const CameraModel> camera; // std::atomic_load / std::atomic_store only
 
     struct RosParameters
     {
@@ -126,14 +171,79 @@ class ballDetector
       double ballRadius;
     } infoDetection;
 
+    // all targets segmented at once from a single HSV conversion
+    struct TargetsSegmentation
+    {
+      std::vector<int> ids;           // target id of each mask
+      std::vector<cv::Mat> masks;     // binary mask of each target
+      std::vector<uint32_t> hueBits;  // for each hue, bitset of the targets accepting it
+      std::vector<colorLUT::Target> targets;
+      std::vector<blobExtractor> extractors; // one per target, contours may run in parallel
+      cv::Mat hsv, blurred, blurred2, labels; // blurred2: chroma or odd Bayer rows
+
+      // search windows of a single target: views of buffers that only grow,
+      // so windows of changing size do not reallocate them
+      struct
+      {
+        cv::Mat hsv, blurred, blurred2, labels;
+        std::vector<cv::Mat> masks;   // one per target
+        std::vector<cv::Mat> none;    // no mask out of the classification
+      } window;
+    } segmentation;
+    colorLUT lut;
+
+    // frame going through the pipeline stages
+    struct PipelineFrame
+    {
+      cv_bridge::CvImageConstPtr image;
+      std::vector<cv::Mat> masks;
+      std::vector<cv::Vec3f> circles;
+    };
+    typedef std::unique_ptr<PipelineFrame> PipelineFramePtr;
+
+    struct Pipeline
+    {
+      std::atomic<bool> running{false};
+      std::vector<std::thread> threads;
+      latestSlot<PipelineFrame> decoded, segmented;
+      spscQueue<PipelineFramePtr, 4> detected;
+      stageSignal decodedSignal, segmentedSignal, detectedSignal;
+    } pipeline;
+
+    // frame budget: quality degraded while frames cost more than the budget
+    struct FrameBudget
+    {
+      double budget = 0;
+      double cost = 0;        // smoothed processing time of a frame
+      int level = DEGRADE_NONE;
+      int hold = 0;           // frames since the last level change
+      uint32_t frames = 0;
+    } frameBudget;
+
     // private variables
     drones::FormationLink outputMessage;
-    std::map<int, KalmanFilterPtr> measuresKF;
-
-    cv::Mat img, img_processed;
+    TargetFilterBank filters{TargetFilterBank::State::Constant(1e-4),
+                             TargetFilterBank::Measure(1e-4, 1e-4, 5e-3),
+                             (TargetFilterBank::State() << 0.01, 0.01, 0.01, 0.001, 0.001).finished()};
+    stageProfiler* profiler = nullptr;
+
+    cv_bridge::CvImageConstPtr frame;
+    cv::Mat img, img_chroma, img_processed, img_small, img_debug;
+    Ingest ingest_ = INGEST_BGR;
     bool img_received = false;
+    uint32_t frame_seq = 0;
+    ros::Time frame_stamp;
     std::vector<int> hue_;
     bool show_segment_ = false, show_output_ = false;
+    bool pipeline_ = false;
+    bool single_pass_ = true;
+    bool use_blobs_ = true;
+    int pyramid_levels_ = 0;
+    double debug_image_scale_ = 1.0;
+    bool use_lut_ = true;
+    bool native_ingest_ = true;
+    bool roi_tracking_ = true;
+    double roi_scale_ = 2.0;
     int sat_ = 100;
     int val_ = 100;
 };
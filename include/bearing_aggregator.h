@@ -0,0 +1,54 @@
+#ifndef BEARING_AGGREGATOR_H
+#define BEARING_AGGREGATOR_H
+
+#include <ros/ros.h>
+
+#include <string>
+#include <vector>
+
+#include <drones/Formation.h>
+#include <drones/FormationLink.h>
+
+#include "formation_buffer.h"
+
+namespace rosdrone_Detector
+{
+
+// Merges the bearing links of any number of observing drones into one
+// Formation. Only the latest link of each observer is kept, and the
+// formation is published as soon as every observer sent a new link, or
+// when the window opened by the first new link closes.
+class bearingAggregator
+{
+  public:
+    bearingAggregator(const ros::NodeHandle& ng, const ros::NodeHandle& nl);
+
+  private:
+    void getParametersROS();
+    void linkCallback(const drones::FormationLink::ConstPtr& link, int observer);
+    void windowCallback(const ros::TimerEvent& event);
+    void publishFormation();
+
+    // ROS Communication
+    ros::NodeHandle nhg, nhl;
+    ros::Publisher formationPub;
+    std::vector<ros::Subscriber> linkSubs;
+    ros::Timer windowTimer;
+
+    // one slot per observer, allocated once
+    struct Slot
+    {
+      drones::FormationLink::ConstPtr link;
+      bool fresh = false;
+    };
+    std::vector<Slot> slots;
+    std::vector<std::string> topics;
+    int fresh = 0;
+    double window = 0.05;
+
+    formationBuffer outputMessage;
+};
+
+}
+
+#endif // BEARING_AGGREGATOR_H
@@ -0,0 +1,83 @@
+#ifndef BEARING_GRAPH_H
+#define BEARING_GRAPH_H
+
+#include <eigen3/Eigen/Eigen>
+#include <utility>
+#include <vector>
+
+namespace rosdrone
+{
+
+// Directed sensing graph of the formation in compressed sparse rows. Edges
+// are sorted by observer, so the outgoing edges of a drone are a contiguous
+// range; the incoming ones are listed by a second index. Per edge values are
+// contiguous arrays indexed by edge, one column per edge for vectors.
+class bearingGraph
+{
+  public:
+    // drones by registry index, duplicated edges are merged
+    void build(int nodes, std::vector<std::pair<int, int>> edges);
+    // every ordered pair of drones, any measure fits in
+    void buildComplete(int nodes);
+
+    int nodes() const { return outOffset.empty() ? 0 : outOffset.size() - 1; }
+    int edges() const { return target.size(); }
+
+    // edge ids of i -> *, and positions in inEdge of * -> i
+    int outBegin(int i) const { return outOffset[i]; }
+    int outEnd(int i) const { return outOffset[i + 1]; }
+    int inBegin(int i) const { return inOffset[i]; }
+    int inEnd(int i) const { return inOffset[i + 1]; }
+
+    // edge id of i -> j, -1 if not in the graph
+    int find(int i, int j) const
+    {
+      if (i < 0 || i >= nodes())
+        return -1;
+      for (int e = outOffset[i]; e < outOffset[i + 1]; e++)
+        if (target[e] == j)
+          return e;
+      return -1;
+    }
+
+    // false if the edge is not in the graph
+    bool measure(int i, int j, const Eigen::Vector3d& g, double d, double t)
+    {
+      int e = find(i, j);
+      if (e < 0)
+        return false;
+      bearing.col(e) = g;
+      distance(e) = d;
+      stamp(e) = t;
+      measured[e] = 1;
+      return true;
+    }
+
+    // measures older than timeout at time now are dropped
+    void expire(double now, double timeout)
+    {
+      for (int e = 0; e < edges(); e++)
+        if (measured[e] && now - stamp(e) > timeout)
+          measured[e] = 0;
+    }
+
+    // topology
+    std::vector<int> outOffset, inOffset;
+    std::vector<int> source, target;
+    std::vector<int> inEdge;
+
+    // per edge values
+    Eigen::Matrix3Xd bearing, desired;
+    Eigen::VectorXd distance, stamp;
+    std::vector<unsigned char> measured;
+
+    // per edge tables of the formation: S g*, distance control and desired
+    // distance
+    Eigen::Matrix3Xd desiredSpin;
+    std::vector<unsigned char> distanceControl;
+    Eigen::VectorXd desiredDistance;
+};
+
+}
+
+#endif // BEARING_GRAPH_H
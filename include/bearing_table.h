@@ -0,0 +1,56 @@
+#ifndef BEARING_TABLE_H
+#define BEARING_TABLE_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/array.hpp>
+#include <eigen3/Eigen/Eigen>
+#include <sensor_msgs/CameraInfo.h>
+
+namespace rosdrone_Detector
+{
+
+// Rays of the image pixels in the body frame, undistorted and rotated once
+// when the camera changes. Rays are sampled every `step` pixels and
+// bilinearly interpolated. They have unit depth in the camera frame: scaled
+// by the depth of a point they give its position.
+class bearingTable
+{
+  public:
+    // false when the camera did not change since the last build
+    bool build(const sensor_msgs::CameraInfo& info, const Eigen::Matrix3d& R, int step = 8);
+    // true when build would keep the table as it is
+    bool matches(const sensor_msgs::CameraInfo& info, const Eigen::Matrix3d& R, int step = 8) const;
+
+    bool empty() const { return rays.empty(); }
+
+    Eigen::Vector3d ray(float u, float v) const
+    {
+      // nodes cover the image, points outside are clamped to its border
+      float x = std::min(std::max(u, 0.0f), maxU) / step;
+      float y = std::min(std::max(v, 0.0f), maxV) / step;
+      int i = std::min<int>(x, cols - 2), j = std::min<int>(y, rows - 2);
+      float a = x - i, b = y - j;
+
+      const Eigen::Vector3f* r0 = &rays[j * cols + i];
+      const Eigen::Vector3f* r1 = r0 + cols;
+      return ((1 - b) * ((1 - a) * r0[0] + a * r0[1]) + b * ((1 - a) * r1[0] + a * r1[1])).cast<double>();
+    }
+
+  private:
+    std::vector<Eigen::Vector3f> rays; // row major nodes
+    int cols = 0, rows = 0, step = 8;
+    float maxU = 0, maxV = 0;
+
+    // camera of the last build
+    int width = 0, height = 0;
+    boost::array<double, 9> K;
+    std::vector<double> D;
+    std::string model;
+    Eigen::Matrix3d R;
+};
+
+}
+
+#endif // BEARING_TABLE_H
@@ -0,0 +1,34 @@
+#ifndef BLOB_EXTRACTOR_H
+#define BLOB_EXTRACTOR_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace rosdrone_Detector
+{
+
+struct Blob
+{
+  int area;
+  cv::Rect box;
+  cv::Point2d centroid;
+};
+
+// Statistics of the 8-connected blobs of a binary mask, all blobs at once.
+// Buffers are kept between calls, use one extractor per thread.
+class blobExtractor
+{
+  public:
+    const std::vector<Blob>& extract(const cv::Mat& mask);
+
+    const std::vector<Blob>& blobs() const { return blobs_; }
+    const cv::Mat& labels() const { return labels_; }
+
+  private:
+    cv::Mat labels_, stats_, centroids_;
+    std::vector<Blob> blobs_;
+};
+
+}
+
+#endif // BLOB_EXTRACTOR_H
@@ -0,0 +1,71 @@
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace rosdrone_Detector
+{
+
+// Quantized BGR (or YUV) -> target lookup table. Each channel is reduced to
+// 2^bits bins and every bin stores the label (index + 1) of the target it
+// belongs to, 0 when it matches none. The table is classified once with the
+// same HSV bounds used by inRange, so no HSV conversion is needed per frame,
+// and camera encodings are classified without converting them to BGR.
+class colorLUT
+{
+  public:
+    static const int bits = 5;
+    static const int bins = 1 << bits;
+
+    struct Target
+    {
+      int hue;                 // center hue, 0..179
+      std::vector<int> ranges; // [min, max] hue pairs as built by colorRGB2HUE
+    };
+
+    // channels of the table: b, g, r or y, u, v (BT.601, as OpenCV converts them)
+    enum Space { BGR, YUV };
+
+    colorLUT();
+
+    void build(const std::vector<Target>& targets, int sat, int val, Space space = BGR);
+    bool needsRebuild(int sat, int val, Space space = BGR) const
+    {
+      return !built || sat != sat_ || val != val_ || space != space_;
+    }
+
+    // The classify functions label every pixel into a CV_8UC1 image and, in the
+    // same row pass, write the binary mask of each of the masks.size() first
+    // labels, so no further pass per target is needed.
+
+    // bgr8 image (CV_8UC3)
+    void classify(const cv::Mat& bgr, cv::Mat& labels, std::vector<cv::Mat>& masks) const;
+    void classifyRow(const uchar* bgr, uchar* labels, int n) const;
+
+    // packed 4:2:2 pixel pairs (CV_8UC4), [Y0 U Y1 V] (YUYV) or [U Y0 V Y1] (UYVY)
+    void classifyYUV422(const cv::Mat& pairs, bool uyvy, cv::Mat& labels, std::vector<cv::Mat>& masks) const;
+    // 4:2:0, luma and half resolution chroma (CV_8UC2), [U V] (NV12) or [V U] (NV21)
+    void classifyYUV420(const cv::Mat& luma, const cv::Mat& chroma, bool vu, cv::Mat& labels, std::vector<cv::Mat>& masks) const;
+    // Bayer quads, top [c0 c1] and bottom [c2 c3] rows at half resolution (CV_8UC2),
+    // red at index red of the quad and blue at 3 - red
+    void classifyBayer(const cv::Mat& top, const cv::Mat& bottom, int red, cv::Mat& labels, std::vector<cv::Mat>& masks) const;
+
+    inline uchar lookup(uchar b, uchar g, uchar r) const
+    {
+      return table[((b >> (8 - bits)) << (2 * bits)) | ((g >> (8 - bits)) << bits) | (r >> (8 - bits))];
+    }
+
+  private:
+    static void createMasks(cv::Size size, std::vector<cv::Mat>& masks);
+    static void maskRow(const uchar* labels, std::vector<cv::Mat>& masks, int y, int n);
+
+    std::vector<uchar> table;
+    int sat_ = -1, val_ = -1;
+    Space space_ = BGR;
+    bool built = false;
+};
+
+}
+
+#endif // COLOR_LUT_H
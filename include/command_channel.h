@@ -0,0 +1,63 @@
+#ifndef COMMAND_CHANNEL_H
+#define COMMAND_CHANNEL_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace rosdrone
+{
+
+// Lock-free triple buffer from one writer thread to one reader thread. The
+// writer fills its back buffer and swaps it with the middle one, the reader
+// swaps its front buffer with the middle one when it holds a newer sample.
+// Neither side ever waits and the reader always sees a complete sample, the
+// latest one written.
+template <typename T>
+class commandChannel
+{
+  public:
+    struct Sample
+    {
+      T value;
+      double stamp = 0;
+      // 0 until something is written
+      uint64_t sequence = 0;
+    };
+
+    // writer only
+    void write(const T& value, double stamp)
+    {
+      Sample& sample = buffers[back];
+      sample.value = value;
+      sample.stamp = stamp;
+      sample.sequence = ++written;
+      back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader only, returns true when a newer sample was taken
+    bool read()
+    {
+      if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        return false;
+      front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+      return true;
+    }
+
+    // reader only, sample taken by the last read()
+    const Sample& latest() const { return buffers[front]; }
+
+  private:
+    static const unsigned INDEX = 3, FRESH = 4;
+
+    Sample buffers[3];
+    alignas(64) std::atomic<unsigned> middle{1};
+    // owned by the writer
+    alignas(64) unsigned back = 0;
+    uint64_t written = 0;
+    // owned by the reader
+    alignas(64) unsigned front = 2;
+};
+
+}
+
+#endif // COMMAND_CHANNEL_H
@@ -9,11 +9,19 @@
 #include <eigen_conversions/eigen_msg.h>
 #include <vector>
 
+#include "bearing_graph.h"
+#include "command_channel.h"
+#include "drone_registry.h"
+#include "formation_spec.h"
+#include "rigidity_monitor.h"
+
 #include <drones/Formation.h>
 #include <drones/FormationLink.h>
 #include <drones/FormationControl.h>
 #include <std_msgs/Float32.h>
 #include <std_msgs/Float32MultiArray.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Float64MultiArray.h>
 
 #include <geometry_msgs/Pose.h>
 #include <geometry_msgs/Twist.h>
@@ -22,17 +30,13 @@
 #include <visualization_msgs/MarkerArray.h>
 #include <visualization_msgs/Marker.h>
 
-extern geometry_msgs::Twist sharedTwist;
-
 namespace rosdrone
 {
-  //static geometry_msgs::Twist getCommand(){ return twist; };
-
   class commandCreator{
 
     public:
       // constructor
-      commandCreator(const ros::NodeHandle& ng, const ros::NodeHandle& np);
+      commandCreator(const ros::NodeHandle& ng, const ros::NodeHandle& np, commandChannel<geometry_msgs::Twist>& commands);
       // destructor
       ~commandCreator();
 
@@ -49,14 +53,16 @@ namespace rosdrone
       void calculateVelocityCommand();
       void updateTwist();
       void publishError();
+      void publishRigidity();
       double getYawFromQuaternion(const geometry_msgs::Quaternion& q);
-      double distanceController(double distance);
+      double distanceController(double distance, double desired);
       void nullSpaceMotions(Eigen::Vector3d& u, double& w);
 
       // callback functions
       void bearingMeasuresCallback(const drones::Formation& measures);
       void posesCallback(const gazebo_msgs::ModelStates& poses);
       void formationControlCallback(const drones::FormationControl& control);
+      void formationCommandCallback(const geometry_msgs::Twist& command);
 
       // private structures
       struct ControlParams
@@ -71,30 +77,24 @@ namespace rosdrone
         double w;
       } velocityCommand;
 
-      struct Measure
-      {
-        Eigen::Vector3d bearing;
-        double yaw;
-        double distance;
-      };
-
       struct PoseStructure
       {
         Eigen::Vector3d p;
         Eigen::Quaterniond q;
         Eigen::Matrix3d R;
         double psi;
+        bool valid = false;
       };
 
       struct DistController
       {
         double last_time_measure = 0.0;
-        double distDesired = 2.0;
       } distController;
 
-      std::map<int, std::map<int, Measure>> relativeBearing;
-      std::map<int, std::map<int, Eigen::Vector3d>> relativeBearingDesired;
-      std::map<int, PoseStructure> posesGazebo;
+      // drones by registry index
+      bearingGraph graph;
+      int distEdge = -1;
+      std::vector<PoseStructure, Eigen::aligned_allocator<PoseStructure>> posesGazebo;
       Eigen::Matrix3d S;
       Eigen::Matrix3d I;
       double start_time;
@@ -105,10 +105,23 @@ namespace rosdrone
       // ROS Communication
       ros::NodeHandle nh, nhp;
       ros::Publisher errorFPub, errorDist, desiredDist;
-      ros::Subscriber poseSub, bearings_sub, formationControlSub;
+      ros::Publisher eigenvaluePub, eigenvectorPub;
+      ros::Subscriber poseSub, bearings_sub, formationControlSub, commandSub;
+
+      // velocity commands handed to the outer loop
+      commandChannel<geometry_msgs::Twist>& commands;
 
       // private variables
       int drone_ID;
+      int drone_index;
+      bool centralized = false;
+      bool monitorRigidity = false;
+      rigidityMonitor rigidity;
+      // every measured edge, not only the controlled ones
+      bearingGraph sensed;
+      double edgeTimeout = 0.5;
+      Eigen::VectorXd psi;
+      droneRegistry registry;
       std::vector<std::pair<int, int> > desired_edges;
   };
 }
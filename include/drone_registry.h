@@ -0,0 +1,47 @@
+#ifndef DRONE_REGISTRY_H
+#define DRONE_REGISTRY_H
+
+#include <ros/ros.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rosdrone
+{
+
+// Dense indices of the drones of the formation, so that per drone state can
+// live in flat arrays. Every drone is known by its uav id, its name in the
+// bearing messages, its mocap subject and its Gazebo model; all of them are
+// resolved through one hash lookup.
+class droneRegistry
+{
+  public:
+    // drones of /uavs_info, optional name, subject and model of each uav_k
+    // default to drone<id>, the name and iris_<id>
+    bool load(const ros::NodeHandle& nh);
+
+    // index of the new drone
+    int add(int id, const std::string& name, const std::string& subject, const std::string& model);
+
+    int size() const { return ids.size(); }
+
+    // index of a name, subject or model, -1 if not a drone. Unknown aliases
+    // are remembered on first sight, so no later lookup misses
+    int index(const std::string& alias);
+    int indexOfId(int id) const;
+
+    int id(int index) const { return ids[index]; }
+    const std::string& name(int index) const { return names[index]; }
+    const std::string& subject(int index) const { return subjects[index]; }
+    const std::string& model(int index) const { return models[index]; }
+
+  private:
+    std::vector<int> ids;
+    std::vector<std::string> names, subjects, models;
+    std::unordered_map<std::string, int> aliases;
+};
+
+}
+
+#endif // DRONE_REGISTRY_H
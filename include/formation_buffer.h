@@ -0,0 +1,66 @@
+#ifndef FORMATION_BUFFER_H
+#define FORMATION_BUFFER_H
+
+#include <ros/ros.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <drones/Formation.h>
+#include <drones/FormationLink.h>
+
+namespace rosdrone_Detector
+{
+
+// Formation message whose links keep their buffers from one message to the
+// next. It holds one link per observer, filled in place; publish() sends the
+// first count of them and moves the others aside meanwhile, so shrinking the
+// message never frees a link nor its vectors.
+class formationBuffer
+{
+  public:
+    void resize(int observers)
+    {
+      message.drones.resize(observers);
+      message.links.resize(observers);
+      parkedDrones.resize(observers);
+      parkedLinks.resize(observers);
+    }
+
+    std_msgs::Header& header() { return message.header; }
+    std::string& drone(int k) { return message.drones[k]; }
+    drones::FormationLink& link(int k) { return message.links[k]; }
+
+    void publish(const ros::Publisher& publisher, int count)
+    {
+      const int observers = message.links.size();
+      for (int k = count; k < observers; k++)
+      {
+        parkedDrones[k - count] = std::move(message.drones[k]);
+        parkedLinks[k - count] = std::move(message.links[k]);
+      }
+      message.drones.resize(count);
+      message.links.resize(count);
+
+      publisher.publish(message);
+
+      // within capacity, nothing is allocated
+      message.drones.resize(observers);
+      message.links.resize(observers);
+      for (int k = count; k < observers; k++)
+      {
+        message.drones[k] = std::move(parkedDrones[k - count]);
+        message.links[k] = std::move(parkedLinks[k - count]);
+      }
+    }
+
+  private:
+    drones::Formation message;
+    std::vector<std::string> parkedDrones;
+    std::vector<drones::FormationLink> parkedLinks;
+};
+
+}
+
+#endif // FORMATION_BUFFER_H
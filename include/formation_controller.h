@@ -0,0 +1,97 @@
+#ifndef FORMATION_CONTROLLER_H
+#define FORMATION_CONTROLLER_H
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Eigen>
+#include <eigen_conversions/eigen_msg.h>
+#include <vector>
+
+#include <drones/Formation.h>
+#include <drones/FormationControl.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <geometry_msgs/Twist.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Float64MultiArray.h>
+
+#include "bearing_graph.h"
+#include "drone_registry.h"
+#include "formation_spec.h"
+#include "rigidity_monitor.h"
+
+namespace rosdrone
+{
+
+// Bearing formation control of every drone in one process. Each tick the
+// commands of all drones are computed in one pass over the edges of the
+// graph with structure of arrays, then sent to the drone operators running
+// in centralized mode.
+class formationController
+{
+  public:
+    formationController(const ros::NodeHandle& ng, const ros::NodeHandle& np);
+
+    // commands of every drone from the current measures and poses
+    void computeCommands();
+
+    const Eigen::Matrix3Xd& linearCommands() const { return u; }
+    const Eigen::VectorXd& angularCommands() const { return w; }
+
+  private:
+    void getROSParameters();
+    void publishCommands();
+    void publishRigidity();
+
+    // callback functions
+    void timerCallback(const ros::TimerEvent& event);
+    void bearingMeasuresCallback(const drones::Formation& measures);
+    void posesCallback(const gazebo_msgs::ModelStates& poses);
+    void formationControlCallback(const drones::FormationControl& control);
+
+    FormationGains controlParams;
+
+    // drones by registry index
+    droneRegistry registry;
+    bearingGraph graph;
+    std::vector<int> distanceEdges;
+
+    // poses, one column or entry per drone
+    Eigen::Matrix3Xd positions;
+    std::vector<Eigen::Matrix3d> rotations;
+    Eigen::VectorXd psi;
+    std::vector<unsigned char> posed;
+
+    // per edge buffers
+    Eigen::ArrayXd mask, dot, spin, c, s;
+    Eigen::Array3Xd projected;
+
+    // outputs
+    Eigen::Matrix3Xd u;
+    Eigen::VectorXd w;
+
+    // optional rigidity eigenvalue of the measured graph, every measured
+    // edge and not only the controlled ones
+    bool monitorRigidity = false;
+    rigidityMonitor rigidity;
+    bearingGraph sensed;
+    double edgeTimeout = 0.5;
+    std_msgs::Float64 eigenvalueMsg;
+    std_msgs::Float64MultiArray eigenvectorMsg;
+
+    // null-space motions
+    bool formation_control_active = false;
+    Eigen::Vector3d _position;
+    double _rotation = 0, _scale = 0;
+
+    // ROS Communication
+    ros::NodeHandle nh, nhp;
+    ros::Subscriber bearingsSub, poseSub, formationControlSub;
+    std::vector<ros::Publisher> commandPubs;
+    ros::Publisher eigenvaluePub, eigenvectorPub;
+    ros::Timer timer;
+    geometry_msgs::Twist commandMsg;
+};
+
+}
+
+#endif // FORMATION_CONTROLLER_H
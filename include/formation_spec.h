@@ -0,0 +1,59 @@
+#ifndef FORMATION_SPEC_H
+#define FORMATION_SPEC_H
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Eigen>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bearing_graph.h"
+#include "drone_registry.h"
+
+namespace rosdrone
+{
+
+struct FormationGains
+{
+  double kc = 0.7;
+  double kp_dist = 0.15;
+  // desired distance of a distance edge: embedding distance times scale
+  double scale = 1.0;
+};
+
+// Desired formation: embedding and yaw of each drone by uav id, controlled
+// edges and gains. Loaded from a formation file, see config/formation.yaml,
+// and compiled once into the per edge tables of a bearing graph. Without a
+// file it is the three drones formation of the experiments.
+class formationSpec
+{
+  public:
+    formationSpec();
+
+    // false and unchanged if the file cannot be read
+    bool load(const std::string& file);
+
+    // file of the /formation_file parameter, if any
+    bool loadROS(const ros::NodeHandle& nh);
+    // same, then the private ~kc, ~kp_dist and ~scale override the gains
+    bool loadROS(const ros::NodeHandle& nh, const ros::NodeHandle& nhp);
+
+    // graph of the controlled edges between the drones of the registry,
+    // with their desired bearings, S g* terms, distance control flags and
+    // desired distances
+    void compile(const droneRegistry& registry, bearingGraph& graph) const;
+
+    FormationGains gains;
+
+  private:
+    std::map<int, Eigen::Vector3d> positions;
+    std::map<int, double> yaws;
+    std::vector<std::pair<int, int>> edges;
+    std::vector<std::pair<int, int>> distanceEdges;
+};
+
+}
+
+#endif // FORMATION_SPEC_H
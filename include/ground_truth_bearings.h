@@ -0,0 +1,90 @@
+#ifndef GROUND_TRUTH_BEARINGS_H
+#define GROUND_TRUTH_BEARINGS_H
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Eigen>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <drones/Formation.h>
+#include <drones/FormationLink.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <qualisys/Subject.h>
+
+#include "drone_registry.h"
+#include "visibility_graph.h"
+
+namespace rosdrone_Detector
+{
+
+// Synthesizes the bearing measures of the formation from the poses given by
+// the motion capture (/qualisys/<subject>) or by Gazebo (/gazebo/model_states).
+// Every configured edge is computed in one batched pass over structure of
+// arrays, each time a full set of poses is received. With ~visibility only
+// the edges a camera could observe are published.
+class groundTruthBearings
+{
+  public:
+    groundTruthBearings(const ros::NodeHandle& ng, const ros::NodeHandle& nl);
+
+    // batched bearings and distances of every edge from the stored poses
+    void computeEdges();
+
+    // pose of a drone, position and rotation body to world
+    void setPose(int drone, const Eigen::Vector3d& position, const Eigen::Quaterniond& orientation);
+
+  private:
+    void getParametersROS();
+    void subjectCallback(const qualisys::Subject::ConstPtr& subject, int drone);
+    void modelStatesCallback(const gazebo_msgs::ModelStates::ConstPtr& states);
+    void addNoise();
+    void publishFormation(const ros::Time& stamp);
+    void publishModelStates();
+
+    // ROS Communication
+    ros::NodeHandle nhg, nhl;
+    ros::Publisher formationPub, modelStatesPub, mocapPosePub;
+    std::vector<ros::Subscriber> poseSubs;
+
+    // drones and configured edges, observer to target
+    rosdrone::droneRegistry registry;
+    std::vector<std::string> names;
+    std::vector<int> edgeFrom, edgeTo;
+    std::vector<int> linkEnd; // one past the last edge of each link
+
+    // poses as structure of arrays, one column per drone. Rotations are
+    // stored column major so that R^T * d is three dot products
+    Eigen::Matrix<double, 3, Eigen::Dynamic> positions;
+    Eigen::Matrix<double, 9, Eigen::Dynamic> rotations;
+    std::vector<Eigen::Quaterniond> orientations;
+    std::vector<bool> seen, fresh;
+    int seenCount = 0, freshCount = 0;
+    ros::Time frameStamp;
+
+    // per edge buffers, one contiguous column per component
+    Eigen::Matrix<double, Eigen::Dynamic, 3> delta, bearings;
+    Eigen::Matrix<double, Eigen::Dynamic, 9> observerRotation;
+    Eigen::VectorXd distances;
+
+    // optional camera visibility, the published links form the sensing graph
+    bool useVisibility = false;
+    visibilityGraph visibility;
+
+    // optional noise emulating a real sensor
+    double bearingNoise = 0.0;
+    double distanceNoise = 0.0;
+    std::mt19937 generator;
+    std::normal_distribution<double> normal;
+
+    int mocapDrone = -1;
+    drones::Formation outputMessage;
+    gazebo_msgs::ModelStates modelStatesMessage;
+    geometry_msgs::PoseStamped mocapPoseMessage;
+};
+
+}
+
+#endif // GROUND_TRUTH_BEARINGS_H
@@ -0,0 +1,117 @@
+#ifndef KALMAN_FILTER_BANK_H
+#define KALMAN_FILTER_BANK_H
+
+#include <vector>
+#include <eigen3/Eigen/Eigen>
+
+namespace rosdrone_Detector
+{
+
+// Bank of constant-velocity Kalman filters with compile-time sizes. The
+// state holds the M measured quantities followed by the velocities of the
+// first N - M of them. Filters live in contiguous slots allocated once, and
+// predict/correct never allocate.
+template <int N, int M>
+class kalmanFilterBank
+{
+  static_assert(N >= M && N - M <= M, "velocities are those of measured quantities");
+
+  public:
+    typedef Eigen::Matrix<float, N, 1> State;
+    typedef Eigen::Matrix<float, M, 1> Measure;
+    typedef Eigen::Matrix<float, N, N> StateCov;
+    typedef Eigen::Matrix<float, M, M> MeasureCov;
+
+    struct Filter
+    {
+      State x;
+      StateCov P;
+      double stamp = 0;        // time of x
+      double last_measure = 0;
+      int missed = 0;          // consecutive updates without measure
+      bool active = false;
+
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    kalmanFilterBank(const State& process_noise, const Measure& measure_noise,
+                     const State& initial_cov, int slots = 0)
+      : filters(slots), Q(process_noise.asDiagonal()), R(measure_noise.asDiagonal()),
+        P0(initial_cov.asDiagonal())
+    {}
+
+    // slots are only allocated here, never while filtering
+    void resize(int slots) { filters.assign(slots, Filter()); }
+
+    int size() const { return filters.size(); }
+    bool active(int slot) const { return filters[slot].active; }
+    const Filter& filter(int slot) const { return filters[slot]; }
+
+    // first measure: position from the measure, zero velocity
+    void init(int slot, const Measure& z, double stamp)
+    {
+      Filter& f = filters[slot];
+      f.x.setZero();
+      f.x.template head<M>() = z;
+      f.P = P0;
+      f.stamp = f.last_measure = stamp;
+      f.missed = 0;
+      f.active = true;
+    }
+
+    void reset(int slot) { filters[slot].active = false; }
+
+    void predict(int slot, double stamp)
+    {
+      Filter& f = filters[slot];
+      const StateCov F = transition(stamp - f.stamp);
+      f.x = F * f.x;
+      f.P = F * f.P * F.transpose() + Q;
+      f.stamp = stamp;
+    }
+
+    void correct(int slot, const Measure& z)
+    {
+      Filter& f = filters[slot];
+      const MeasureCov S = f.P.template topLeftCorner<M, M>() + R;
+      const Eigen::Matrix<float, N, M> K = f.P.template leftCols<M>() * S.inverse();
+      f.x += K * (z - f.x.template head<M>());
+      f.P -= K * f.P.template topRows<M>();
+      f.last_measure = f.stamp;
+      f.missed = 0;
+    }
+
+    // a priori estimate at any time, the filter itself is left untouched
+    State predicted(int slot, double stamp) const
+    {
+      const Filter& f = filters[slot];
+      return transition(stamp - f.stamp) * f.x;
+    }
+
+    StateCov predictedCov(int slot, double stamp) const
+    {
+      const Filter& f = filters[slot];
+      const StateCov F = transition(stamp - f.stamp);
+      return F * f.P * F.transpose() + Q;
+    }
+
+    void missedMeasure(int slot) { filters[slot].missed++; }
+
+  private:
+    static StateCov transition(double dT)
+    {
+      StateCov F = StateCov::Identity();
+      for (int i = 0; i < N - M; i++)
+        F(i, M + i) = dT;
+      return F;
+    }
+
+    std::vector<Filter, Eigen::aligned_allocator<Filter> > filters;
+    StateCov Q;
+    MeasureCov R;
+    StateCov P0;
+};
+
+}
+
+#endif // KALMAN_FILTER_BANK_H
@@ -18,12 +18,14 @@
 #include <mavros_msgs/PositionTarget.h>
 #include <geometry_msgs/PoseStamped.h>
 
+#include "command_channel.h"
+
 namespace rosdrone
 {
   class outerLoopRT{
     public:
       // constructor
-      outerLoopRT(const ros::NodeHandle& nh);
+      outerLoopRT(const ros::NodeHandle& nh, const ros::NodeHandle& np, commandChannel<geometry_msgs::Twist>& commands);
       // destructor
       ~outerLoopRT();
 
@@ -52,10 +54,12 @@ namespace rosdrone
         Eigen::Vector3d p;
         Eigen::Quaterniond q;
         Eigen::Matrix3d R;
-      } pose;
+      };
+      // written by the pose callback, which may run on another thread
+      commandChannel<PoseStructure> poses;
 
       // ROS Communication
-      ros::NodeHandle nh;
+      ros::NodeHandle nh, nhp;
       ros::Publisher controlPub;
       ros::Subscriber poseSub, stateSub;
 
@@ -64,10 +68,15 @@ namespace rosdrone
       mavros_msgs::CommandBool arm_cmd;
 
       // Messages
-      geometry_msgs::PoseStamped poseMsgIn;
       mavros_msgs::State current_state;
       geometry_msgs::Twist vel_command;
 
+      // velocity commands of the commandCreator, older than
+      // commandTimeout they are replaced by a hover
+      commandChannel<geometry_msgs::Twist>& commands;
+      double commandTimeout = 0.5;
+      bool commandStale = false;
+
       // private variables
       double last_service_call = 0;
       double serviceDelay = 5;
@@ -0,0 +1,29 @@
+#ifndef PARALLEL_LOOP_H
+#define PARALLEL_LOOP_H
+
+#include <opencv2/core/core.hpp>
+
+namespace rosdrone_Detector
+{
+
+// cv::parallel_for_ over a callable, the lambda overload is missing from OpenCV < 3.3
+template <typename Body>
+class parallelLoop : public cv::ParallelLoopBody
+{
+  public:
+    explicit parallelLoop(const Body& body) : body_(body) {}
+    void operator()(const cv::Range& range) const override { body_(range); }
+
+  private:
+    const Body& body_;
+};
+
+template <typename Body>
+void parallelFor(const cv::Range& range, const Body& body)
+{
+  cv::parallel_for_(range, parallelLoop<Body>(body));
+}
+
+}
+
+#endif // PARALLEL_LOOP_H
@@ -0,0 +1,70 @@
+#ifndef REALTIME_LOOP_H
+#define REALTIME_LOOP_H
+
+#include <ros/ros.h>
+#include <time.h>
+#include <vector>
+
+#include <drones/LoopStatistics.h>
+
+namespace rosdrone
+{
+
+struct RealtimeOptions
+{
+  double rate = 100.0;
+  // SCHED_FIFO priority, 0 keeps the default scheduler
+  int priority = 0;
+  // core the loop is pinned to, -1 for any
+  int cpu = -1;
+  bool lockMemory = true;
+  double statisticsRate = 1.0;
+  double binWidth = 50e-6;
+  int bins = 40;
+};
+
+// Fixed rate loop on CLOCK_MONOTONIC. Each period ends on an absolute
+// deadline, so a late iteration does not shift the following ones; when a
+// deadline is missed the skipped periods are counted and the loop realigns
+// on the next one. Jitter is the wake up delay after the deadline, compute
+// time the span between wake up and the next wait().
+class realtimeLoop
+{
+  public:
+    realtimeLoop(const ros::NodeHandle& np, const RealtimeOptions& options);
+
+    // scheduler, affinity and memory locking of the calling thread,
+    // failures are reported and the loop runs without them
+    void configure();
+    void start();
+    // sleeps until the next deadline
+    void wait();
+    // at the statistics rate
+    void publishStatistics();
+
+  private:
+    static double seconds(const timespec& t) { return t.tv_sec + 1e-9 * t.tv_nsec; }
+    void advance(timespec& t, long nanoseconds);
+    void record(std::vector<uint32_t>& histogram, double t);
+
+    RealtimeOptions options;
+    long period;
+    timespec deadline, wakeup;
+    bool computing = false;
+
+    // running counters
+    uint64_t iterations = 0, missed = 0;
+    std::vector<uint32_t> jitterHistogram, computeHistogram;
+    // since the last message
+    int samples = 0;
+    double jitterSum = 0, jitterMax = 0, computeSum = 0, computeMax = 0;
+    double lastPublished = 0;
+
+    ros::NodeHandle nhp;
+    ros::Publisher statisticsPub;
+    drones::LoopStatistics statistics;
+};
+
+}
+
+#endif // REALTIME_LOOP_H
@@ -0,0 +1,56 @@
+#ifndef RIGIDITY_MONITOR_H
+#define RIGIDITY_MONITOR_H
+
+#include <eigen3/Eigen/Eigen>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+#include <vector>
+
+#include "bearing_graph.h"
+
+namespace rosdrone
+{
+
+// Rigidity eigenvalue of the measured bearing graph in R3 x S1. The bearing
+// rigidity matrix B has one 3 row block per measured edge and the velocity
+// and yaw rate of each drone in its body frame as columns. B^T B always has
+// the 5 trivial motions (3 translations, scaling, rotation about z) in its
+// kernel; the formation is infinitesimally rigid when its 6th eigenvalue is
+// positive. The 6 smallest eigenpairs are tracked by block LOBPCG,
+// preconditioned by a sparse factorization of B^T B and started from the
+// previous update, so a few iterations per tick are enough.
+class rigidityMonitor
+{
+  public:
+    static const int TRIVIAL = 5;
+
+    // yaw of each drone, only the differences are used
+    void update(const bearingGraph& graph, const Eigen::VectorXd& psi);
+
+    double eigenvalue() const { return lambda; }
+    const Eigen::VectorXd& eigenvector() const { return vector; }
+    int iterations() const { return lastIterations; }
+
+    int maxIterations = 20;
+    double tolerance = 1e-6;
+
+  private:
+    void buildMatrix(const bearingGraph& graph, const Eigen::VectorXd& psi);
+    void apply(const Eigen::MatrixXd& x, Eigen::MatrixXd& y);
+
+    Eigen::SparseMatrix<double> B, M, shifted;
+    std::vector<Eigen::Triplet<double>> triplets;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> preconditioner;
+
+    // block of eigenvectors kept between updates, search directions
+    Eigen::MatrixXd X, AX, R, W, P, basis, Abasis;
+    Eigen::VectorXd values;
+
+    double lambda = 0;
+    Eigen::VectorXd vector;
+    int lastIterations = 0;
+};
+
+}
+
+#endif // RIGIDITY_MONITOR_H
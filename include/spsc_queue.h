@@ -0,0 +1,102 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace rosdrone_Detector
+{
+
+// Bounded lock-free queue for one producer thread and one consumer thread.
+template <typename T, size_t N>
+class spscQueue
+{
+  public:
+    // the item is left untouched when the queue is full
+    bool push(T&& item)
+    {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      const size_t next = (head + 1) % (N + 1);
+      if (next == tail_.load(std::memory_order_acquire))
+        return false;
+
+      buffer_[head] = std::move(item);
+      head_.store(next, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(T& item)
+    {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail == head_.load(std::memory_order_acquire))
+        return false;
+
+      item = std::move(buffer_[tail]);
+      tail_.store((tail + 1) % (N + 1), std::memory_order_release);
+      return true;
+    }
+
+  private:
+    std::array<T, N + 1> buffer_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+// Single lock-free slot where the latest item wins: putting an item
+// discards the one not yet taken, so a slow consumer never builds latency.
+template <typename T>
+class latestSlot
+{
+  public:
+    ~latestSlot() { delete slot_.exchange(nullptr); }
+
+    // returns true when an item not yet taken was dropped
+    bool put(std::unique_ptr<T> item)
+    {
+      std::unique_ptr<T> dropped(slot_.exchange(item.release(), std::memory_order_acq_rel));
+      return dropped != nullptr;
+    }
+
+    std::unique_ptr<T> take()
+    {
+      return std::unique_ptr<T>(slot_.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+  private:
+    std::atomic<T*> slot_{nullptr};
+};
+
+// Wakes up a stage waiting for work. Only sleeping uses the mutex, the
+// data itself goes through the lock-free containers above.
+class stageSignal
+{
+  public:
+    void notify()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = true;
+      }
+      cv_.notify_one();
+    }
+
+    void wait(std::chrono::milliseconds timeout)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, timeout, [this]{ return pending_; });
+      pending_ = false;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool pending_ = false;
+};
+
+}
+
+#endif // SPSC_QUEUE_H
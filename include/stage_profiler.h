@@ -0,0 +1,93 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace rosdrone_Detector
+{
+
+// Per-frame timings of the detector stages. Stages are accumulated over a
+// frame (e.g. one contour search per target) and stored by endFrame().
+// Not thread safe: only used by the sequential detector.
+class stageProfiler
+{
+  public:
+    enum Stage { CONVERT, SEGMENT, CONTOUR, KALMAN, OUTPUT, FRAME, STAGES };
+
+    static const char* name(int stage)
+    {
+      static const char* names[STAGES] = {"convert", "segment", "contour", "kalman", "output", "frame"};
+      return names[stage];
+    }
+
+    // times its own lifetime, nothing is done without profiler
+    class Scope
+    {
+      public:
+        Scope(stageProfiler* profiler, Stage stage) : profiler(profiler), stage(stage)
+        {
+          if (profiler)
+            start = std::chrono::steady_clock::now();
+        }
+        ~Scope()
+        {
+          if (profiler)
+            profiler->add(stage, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+      private:
+        stageProfiler* profiler;
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // samples are reserved beforehand so that profiling does not allocate
+    void reserve(int frames)
+    {
+      for(auto& s : samples)
+        s.reserve(frames);
+    }
+
+    void add(Stage stage, double seconds) { current[stage] += seconds; }
+
+    void endFrame()
+    {
+      for(int i = 0; i < STAGES; i++)
+      {
+        samples[i].push_back(current[i]);
+        current[i] = 0;
+      }
+    }
+
+    int frames() const { return samples[FRAME].size(); }
+
+    // p in [0, 1], nearest rank
+    double percentile(Stage stage, double p)
+    {
+      std::vector<double>& s = samples[stage];
+      if (s.empty())
+        return 0;
+      std::vector<double>::iterator nth = s.begin() + std::min<int>(p * s.size(), s.size() - 1);
+      std::nth_element(s.begin(), nth, s.end());
+      return *nth;
+    }
+
+    double mean(Stage stage) const
+    {
+      const std::vector<double>& s = samples[stage];
+      double sum = 0;
+      for(double t : s)
+        sum += t;
+      return s.empty() ? 0 : sum / s.size();
+    }
+
+  private:
+    std::vector<double> samples[STAGES];
+    double current[STAGES] = {};
+};
+
+}
+
+#endif // STAGE_PROFILER_H
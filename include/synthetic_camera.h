@@ -0,0 +1,59 @@
+#ifndef SYNTHETIC_CAMERA_H
+#define SYNTHETIC_CAMERA_H
+
+#include <vector>
+#include <eigen3/Eigen/Eigen>
+#include <opencv2/core/core.hpp>
+#include <sensor_msgs/CameraInfo.h>
+
+namespace rosdrone_Detector
+{
+
+// image degradations, and the mounting of camera and balls (same as the detector)
+struct RendererOptions
+{
+  double noise = 0;     // std of the gaussian pixel noise
+  double blur = 0;      // std of the gaussian blur, pixels
+  int clutter = 0;      // random shapes drawn on the background
+  unsigned int seed = 1;
+  double ballRadius = 0.09;
+  Eigen::Vector3d t_ball2drone = Eigen::Vector3d(0, 0, 0.15);
+  Eigen::Vector3d t_camera2drone = Eigen::Vector3d(0.07, 0.0, 0.055);
+};
+
+// Headless renderer of the coloured balls carried by the drones, for the
+// camera of a CameraInfo. Drone positions are expressed in the body frame
+// of the observing drone, like the bearings of the detector.
+class syntheticCamera
+{
+  public:
+    struct Target
+    {
+      int id;
+      Eigen::Vector3d position;
+      cv::Scalar bgr;
+    };
+
+    syntheticCamera(const sensor_msgs::CameraInfo& info, const RendererOptions& options);
+
+    // circle of the ball of a drone in the image, false behind the camera
+    bool project(const Eigen::Vector3d& position, cv::Vec3f& circle) const;
+    // whole ball inside the image
+    bool visible(const Eigen::Vector3d& position) const;
+    // position of the drone whose ball is centred on pixel (u, v) at depth z
+    Eigen::Vector3d unproject(double u, double v, double z) const;
+
+    void render(const std::vector<Target>& targets, cv::Mat& bgr);
+
+  private:
+    RendererOptions options;
+    Eigen::Matrix3d K, R;  // R: camera to body
+    int width, height;
+    cv::RNG rng;
+    cv::Mat background, noise, image16;
+    std::vector<std::pair<double, int>> order;
+};
+
+}
+
+#endif // SYNTHETIC_CAMERA_H
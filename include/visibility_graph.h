@@ -0,0 +1,52 @@
+#ifndef VISIBILITY_GRAPH_H
+#define VISIBILITY_GRAPH_H
+
+#include <eigen3/Eigen/Eigen>
+
+namespace rosdrone_Detector
+{
+
+struct VisibilityOptions
+{
+  double fovHorizontal = 1.57; // full angles of the camera [rad]
+  double fovVertical = 1.2;
+  double rangeMin = 0.2;       // [m], from the camera
+  double rangeMax = 10.0;
+  double occluderRadius = 0.25; // drones as spheres, 0 disables occlusion
+  Eigen::Matrix3d R_camera2drone = (Eigen::Matrix3d() << 0, 0, 1, -1, 0, 0, 0, -1, 0).finished();
+  Eigen::Vector3d t_camera2drone = Eigen::Vector3d(0.07, 0.0, 0.055);
+};
+
+// Which drone can see which. Each update tests every ordered pair against
+// the camera frustum, the range limits and the occlusion by the other
+// drones, one observer at a time over all targets with matrix operations.
+class visibilityGraph
+{
+  public:
+    visibilityGraph(const VisibilityOptions& options = VisibilityOptions());
+
+    // poses as columns, rotations body to world stored column major
+    void update(const Eigen::Matrix<double, 3, Eigen::Dynamic>& positions,
+                const Eigen::Matrix<double, 9, Eigen::Dynamic>& rotations);
+
+    bool visible(int observer, int target) const { return sees(target, observer) != 0; }
+    int edges() const { return count; }
+
+  private:
+    VisibilityOptions options;
+    double tanHorizontal, tanVertical;
+
+    // sees(target, observer), one column per observer
+    Eigen::Array<unsigned char, Eigen::Dynamic, Eigen::Dynamic> sees;
+    int count = 0;
+
+    // buffers of one observer, kept between updates
+    Eigen::Matrix<double, 3, Eigen::Dynamic> relative, camera, candidates;
+    Eigen::MatrixXd gram;
+    Eigen::ArrayXd squaredRange, squaredNorms, along;
+    Eigen::ArrayXi candidateIndex;
+};
+
+}
+
+#endif // VISIBILITY_GRAPH_H
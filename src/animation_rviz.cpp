@@ -7,11 +7,16 @@ animationRviz::animationRviz(const ros::NodeHandle& n) : nh(n)
 {
   markers_pub = nh.advertise<visualization_msgs::MarkerArray>("visualization_marker_array", 5);
 
-  for(int i = 1; i <=3 ; i++)
+  // per drone state is indexed by the registry
+  registry.load(nh);
+  posesGazebo.resize(registry.size());
+  twists.resize(registry.size());
+  for(int i = 0; i < registry.size(); i++)
   {
+    frames.push_back("uav" + std::to_string(registry.id(i)) + "/base_link");
     twistSub.push_back(
           nh.subscribe<geometry_msgs::Twist>(
-            "/uav" + std::to_string(i) + "/mavros/setpoint_velocity/cmd_vel_unstamped", 2,
+            "/uav" + std::to_string(registry.id(i)) + "/mavros/setpoint_velocity/cmd_vel_unstamped", 2,
             boost::bind(&animationRviz::twistCommandCallBack, this, _1, i))
           );
   }
@@ -30,25 +35,9 @@ animationRviz::~animationRviz()
 
 void animationRviz::setRelativeBearingDesired()
 {
-  std::vector<Eigen::Vector3d> drones;
-  drones.emplace_back(-1, 0, -0.3);
-  drones.emplace_back(sqrt(2)/2, sqrt(2)/2, 0.3);
-  drones.emplace_back(sqrt(2)/2, -sqrt(2)/2, 0);
-
-  Eigen::Matrix3d Rtemp;
-  std::vector<Eigen::Matrix3d> R;
-  Rtemp = Eigen::AngleAxisd(0.0, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-  Rtemp = Eigen::AngleAxisd(M_PI*7/8, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-  Rtemp = Eigen::AngleAxisd(-M_PI/2, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-
-  std::vector<std::pair<int, int> > pairs = { {1, 2}, {1,3}, {2,1}, {3,2} };
-
-  for(auto pair : pairs)
-    relativeBearingDesired[pair.first][pair.second] =
-        (R[pair.first-1]*(drones[pair.second-1] - drones[pair.first-1])).normalized();
+  rosdrone::formationSpec spec;
+  spec.loadROS(nh);
+  spec.compile(registry, desiredGraph);
 }
 
 void animationRviz::addMarker(const int& frame_drone_ID, const int& vector_ID, const Eigen::Vector3d& vector, std::string ns, Eigen::Vector3i color, double length, double thickness)
@@ -57,7 +46,7 @@ void animationRviz::addMarker(const int& frame_drone_ID, const int& vector_ID, c
 
   marker.header.frame_id = "local_origin";
   marker.header.stamp = ros::Time();
-  marker.ns = ns + "_" + std::to_string(frame_drone_ID);
+  marker.ns = ns + "_" + std::to_string(registry.id(frame_drone_ID));
   marker.id = vector_ID;
   marker.type = visualization_msgs::Marker::ARROW;
   marker.action = visualization_msgs::Marker::ADD;
@@ -100,44 +89,47 @@ void animationRviz::addMeasuresArrows()
 {
   for (int i = 0; i < vectorMeasures.size(); i++)
   {
-    // int id_drone = vectorMeasures[i].drone_name.at(vectorMeasures[i].drone_name.length() - 1) - 48 - 3 ; // experimental
-    // int id_target = vectorMeasures[i].target_name.at(vectorMeasures[i].target_name.length() - 1) - 48 - 3; // experimental
-    int id_drone = vectorMeasures[i].drone_name.at(vectorMeasures[i].drone_name.length() - 1) - 48; // simulation
-    int id_target = vectorMeasures[i].target_name.at(vectorMeasures[i].target_name.length() - 1) - 48; // simulation
     Eigen::Vector3i color(1, 0, 1);
-    addMarker(id_drone, id_target, vectorMeasures[i].bearing, "measure", color, vectorMeasures[i].distance, 0.03);
+    addMarker(vectorMeasures[i].drone, registry.id(vectorMeasures[i].target), vectorMeasures[i].bearing, "measure",
+              color, vectorMeasures[i].distance, 0.03);
   }
 }
 
 void animationRviz::addDesiredArrows()
 {
-  for(auto measures_drone : relativeBearingDesired)
+  for(int e = 0; e < desiredGraph.edges(); e++)
   {
-    for(auto measure : measures_drone.second)
-    {
-      Eigen::Vector3i color((measure.first == 1), (measure.first == 2), (measure.first == 3));
-      addMarker(measures_drone.first, measure.first, measure.second, "desired", color, 1.5, 0.05);
-    }
+    int target_id = registry.id(desiredGraph.target[e]);
+    Eigen::Vector3i color((target_id == 1), (target_id == 2), (target_id == 3));
+    addMarker(desiredGraph.source[e], target_id, desiredGraph.desired.col(e), "desired", color, 1.5, 0.05);
   }
 }
 
 void animationRviz::addVelocityArrows()
 {
-  for(auto twist : twists)
+  for(int i = 0; i < twists.size(); i++)
   {
-      Eigen::Vector3i color(1, 1, 0);
-      addMarker(twist.first, 1, twist.second.v, "velocity", color, 1.5, 0.02);
+    if (!twists[i].initialized)
+      continue;
+    Eigen::Vector3i color(1, 1, 0);
+    addMarker(i, 1, twists[i].v, "velocity", color, 1.5, 0.02);
   }
 }
 
 void animationRviz::addCentroid()
 {
-  Eigen::Vector3d translation, centroid;
-  for (auto drone : posesGazebo)
+  Eigen::Vector3d translation, centroid = Eigen::Vector3d::Zero();
+  int seen = 0;
+  for (auto& drone : posesGazebo)
   {
-    centroid += drone.second.p;
+    if (!drone.valid)
+      continue;
+    centroid += drone.p;
+    seen++;
   }
-  centroid /= posesGazebo.size();
+  if (seen == 0)
+    return;
+  centroid /= (double)seen;
 
   visualization_msgs::Marker marker;
 
@@ -164,7 +156,7 @@ void animationRviz::addCentroid()
   translation << 0,0,0;
 
   Eigen::Vector3i color(0, 1, 1);
-  addMarker(1, 1, translation, "tranlation", color, -1, 0.02);
+  addMarker(0, 1, translation, "tranlation", color, -1, 0.02);
 }
 
 void animationRviz::publishMarkers()
@@ -185,10 +177,10 @@ void animationRviz::broadcastingTransformsCallback(const gazebo_msgs::ModelState
 {
   for (int i = 0; i < poses.name.size(); i++)
   {
-    if (poses.name[i].find("iris_") != std::string::npos)
+    int id = registry.index(poses.name[i]);
+    if (id >= 0)
     {
-      int id = poses.name[i].at(poses.name[i].length() - 1) - 48;
-
+      posesGazebo[id].valid = true;
       tf::pointMsgToEigen(poses.pose[i].position, posesGazebo[id].p);
       tf::quaternionMsgToEigen(poses.pose[i].orientation, posesGazebo[id].q);
       posesGazebo[id].q.normalize();
@@ -205,7 +197,7 @@ void animationRviz::broadcastingTransformsCallback(const gazebo_msgs::ModelState
 
       br.sendTransform(tf::StampedTransform(transform, ros::Time::now(),
                                             "local_origin",
-                                            "uav" + std::to_string(id) + "/base_link"));
+                                            frames[id]));
     }
   }
 }
@@ -215,10 +207,14 @@ void animationRviz::measuresCallback(const drones::Formation& measures)
   MsgEstimatedDronePosition measure;
   for (int i=0; i<measures.links.size(); i++)
   {
-    measure.drone_name = measures.links[i].drone_name;
+    measure.drone = registry.index(measures.links[i].drone_name);
+    if (measure.drone < 0)
+      continue;
     for (int j=0; j<measures.links[i].targets.size(); j++)
     {
-      measure.target_name = measures.links[i].targets[j];
+      measure.target = registry.index(measures.links[i].targets[j]);
+      if (measure.target < 0)
+        continue;
 
       Eigen::Vector3d bearing;
       tf::vectorMsgToEigen(measures.links[i].bearings[j], measure.bearing);
@@ -234,6 +230,7 @@ void animationRviz::twistCommandCallBack(const ros::MessageEvent<geometry_msgs::
 {
   const geometry_msgs::Twist::ConstPtr& msg = event.getMessage();
   auto twistMsgIn = *msg.get();
+  twists[drone_ID].initialized = true;
   twists[drone_ID].v <<   twistMsgIn.linear.x,
                           twistMsgIn.linear.y,
                           twistMsgIn.linear.z;
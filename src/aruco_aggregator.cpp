@@ -0,0 +1,191 @@
+#include "aruco_aggregator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <eigen_conversions/eigen_msg.h>
+
+namespace rosdrone_Detector
+{
+
+// constructor
+arucoAggregator::arucoAggregator(const ros::NodeHandle& ng, const ros::NodeHandle& nl) : nhg(ng), nhl(nl)
+{
+  R_camera2drone << 0, 0, 1, -1, 0, 0, 0, -1, 0;
+  t_camera2drone << 0.07, 0.0, 0.055;
+  t_target2baseLink << 0.0, -0.16, -0.085;
+
+  getParametersROS();
+
+  // output buffers are reused for every set
+  slots.resize(topics.size());
+  bestTransform.resize(ids.size());
+  bestArea.resize(ids.size());
+  outputMessage.resize(topics.size());
+
+  // initialize communications
+  formationPub = nhg.advertise<drones::Formation>("/bearings", 1);
+  for(unsigned int k = 0; k < topics.size(); k++)
+    measureSubs.push_back(nhg.subscribe<fiducial_msgs::FiducialTransformArray>(
+                            topics[k], 1, boost::bind(&arucoAggregator::measureCallback, this, _1, k)));
+  windowTimer = nhg.createTimer(ros::Duration(window), &arucoAggregator::windowCallback, this, true, false);
+
+  ROS_INFO("ArUco aggregator initialized with %d observers", (int)topics.size());
+}
+
+void arucoAggregator::getParametersROS()
+{
+  nhl.param("slop", slop, 0.01);
+  nhl.param("window", window, 0.05);
+
+  rosdrone::droneRegistry registry;
+  registry.load(nhg);
+  for (int i = 0; i < registry.size(); i++)
+  {
+    ids.push_back(registry.id(i));
+    names.push_back(registry.name(i));
+  }
+
+  // fiducial transforms of every drone unless given, in the order of /uavs_info
+  if (!nhl.getParam("topics", topics))
+    for (int id : ids)
+      topics.push_back("/uav" + std::to_string(id) + "/aruco_detect/fiducial_transforms");
+  else if (topics.size() != ids.size())
+  {
+    ROS_ERROR("~topics needs one topic per drone of /uavs_info");
+    topics.resize(std::min(topics.size(), ids.size()));
+  }
+
+  // consecutive tags per drone unless the owner of each tag is given
+  std::vector<int> owners;
+  if (nhl.getParam("tag_owners", owners))
+  {
+    for (int owner : owners)
+    {
+      int index = std::find(ids.begin(), ids.end(), owner) - ids.begin();
+      tagOwner.push_back(index < (int)ids.size() ? index : -1);
+    }
+  }
+  else
+  {
+    int tags_per_drone;
+    nhl.param("tags_per_drone", tags_per_drone, 4);
+    for (unsigned int i = 0; i < ids.size(); i++)
+      tagOwner.insert(tagOwner.end(), tags_per_drone, i);
+  }
+
+  std::vector<double> t;
+  if (nhl.getParam("t_camera2drone", t) && t.size() == 3)
+    t_camera2drone << t[0], t[1], t[2];
+  if (nhl.getParam("t_target2baseLink", t) && t.size() == 3)
+    t_target2baseLink << t[0], t[1], t[2];
+}
+
+// callback functions
+
+void arucoAggregator::measureCallback(const fiducial_msgs::FiducialTransformArray::ConstPtr& msg, int observer)
+{
+  // a later capture closes the pending set
+  if (fresh && std::abs((msg->header.stamp - setStamp).toSec()) > slop)
+    publishFormation();
+
+  // the first array of a set gives its capture time
+  if (!fresh)
+    setStamp = msg->header.stamp;
+
+  Slot& slot = slots[observer];
+  slot.measures = msg;
+  if (!slot.fresh)
+  {
+    slot.fresh = true;
+    fresh++;
+  }
+
+  // a full set goes out at once, otherwise the first array opens the window
+  if (fresh == (int)slots.size())
+    publishFormation();
+  else if (fresh == 1)
+  {
+    windowTimer.setPeriod(ros::Duration(window));
+    windowTimer.start();
+  }
+}
+
+void arucoAggregator::windowCallback(const ros::TimerEvent& event)
+{
+  if (fresh)
+    publishFormation();
+}
+
+void arucoAggregator::fillLink(const fiducial_msgs::FiducialTransformArray& measures, drones::FormationLink& link)
+{
+  // keep the largest, hence most accurate, fiducial of each target
+  std::fill(bestTransform.begin(), bestTransform.end(), -1);
+  for (unsigned int i = 0; i < measures.transforms.size(); i++)
+  {
+    const fiducial_msgs::FiducialTransform& transform = measures.transforms[i];
+    if (transform.fiducial_id < 0 || transform.fiducial_id >= (int)tagOwner.size())
+      continue;
+    int target = tagOwner[transform.fiducial_id];
+    if (target < 0)
+      continue;
+    if (bestTransform[target] < 0 || bestArea[target] < transform.fiducial_area)
+    {
+      bestTransform[target] = i;
+      bestArea[target] = transform.fiducial_area;
+    }
+  }
+
+  link.targets.clear();
+  link.bearings.clear();
+  link.distances.clear();
+  Eigen::Vector3d position, bearing;
+  Eigen::Quaterniond orientation;
+  for (unsigned int target = 0; target < bestTransform.size(); target++)
+  {
+    if (bestTransform[target] < 0)
+      continue;
+    const geometry_msgs::Transform& T = measures.transforms[bestTransform[target]].transform;
+
+    tf::vectorMsgToEigen(T.translation, position);
+    tf::quaternionMsgToEigen(T.rotation, orientation);
+    position += orientation.toRotationMatrix() * t_target2baseLink;
+    bearing = R_camera2drone * position + t_camera2drone;
+
+    link.targets.push_back(names[target]);
+    link.distances.emplace_back();
+    link.distances.back().data = bearing.norm();
+    link.bearings.emplace_back();
+    tf::vectorEigenToMsg(bearing.normalized(), link.bearings.back());
+  }
+}
+
+void arucoAggregator::publishFormation()
+{
+  windowTimer.stop();
+
+  // links are filled in place, so their buffers are reused by the next sets
+  int count = 0;
+  for (unsigned int k = 0; k < slots.size(); k++)
+  {
+    Slot& slot = slots[k];
+    if (!slot.fresh)
+      continue;
+    slot.fresh = false;
+    if (slot.measures->transforms.empty())
+      continue;
+
+    drones::FormationLink& link = outputMessage.link(count);
+    link.drone_name = names[k];
+    fillLink(*slot.measures, link);
+    outputMessage.drone(count) = link.drone_name;
+    count++;
+  }
+  fresh = 0;
+
+  // stamped with the capture time of the set
+  outputMessage.header().stamp = setStamp;
+  outputMessage.publish(formationPub, count);
+}
+
+}
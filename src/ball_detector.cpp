@@ -3,24 +3,119 @@
 namespace rosdrone_Detector
 {
 
+namespace
+{
+
+struct NativeEncoding
+{
+  const char* encoding;
+  Ingest ingest;
+  int toBGR;
+};
+
+// ROS yuv422 is UYVY, OpenCV names Bayer patterns after their second row
+const NativeEncoding nativeEncodings[] =
+{
+  {"yuv422", INGEST_UYVY, cv::COLOR_YUV2BGR_UYVY},
+  {"uyvy", INGEST_UYVY, cv::COLOR_YUV2BGR_UYVY},
+  {"yuv422_yuy2", INGEST_YUYV, cv::COLOR_YUV2BGR_YUYV},
+  {"yuyv", INGEST_YUYV, cv::COLOR_YUV2BGR_YUYV},
+  {"nv12", INGEST_NV12, cv::COLOR_YUV2BGR_NV12},
+  {"nv21", INGEST_NV21, cv::COLOR_YUV2BGR_NV21},
+  {"bayer_rggb8", INGEST_BAYER_RGGB, cv::COLOR_BayerBG2BGR},
+  {"bayer_grbg8", INGEST_BAYER_GRBG, cv::COLOR_BayerGB2BGR},
+  {"bayer_gbrg8", INGEST_BAYER_GBRG, cv::COLOR_BayerGR2BGR},
+  {"bayer_bggr8", INGEST_BAYER_BGGR, cv::COLOR_BayerRG2BGR},
+};
+
+// conversion of a native frame to bgr8, -1 for bgr8 frames
+int debugConversion(const std::string& encoding)
+{
+  for(const NativeEncoding& native : nativeEncodings)
+    if (encoding == native.encoding)
+      return native.toBGR;
+  return -1;
+}
+
+// frame sharing the message buffer, which it keeps alive
+cv_bridge::CvImageConstPtr nativeImage(const sensor_msgs::ImageConstPtr& image, Ingest ingest)
+{
+  uchar* data = const_cast<uchar*>(image->data.data());
+  cv::Mat raw;
+  if (ingest == INGEST_YUYV || ingest == INGEST_UYVY)
+    raw = cv::Mat(image->height, image->width, CV_8UC2, data, image->step);
+  else if (ingest == INGEST_NV12 || ingest == INGEST_NV21)
+    raw = cv::Mat(image->height * 3 / 2, image->width, CV_8UC1, data, image->step);
+  else
+    raw = cv::Mat(image->height, image->width, CV_8UC1, data, image->step);
+  if (image->data.size() < raw.rows * image->step)
+    throw cv_bridge::Exception("Image data smaller than its size");
+
+  return cv_bridge::CvImageConstPtr(new cv_bridge::CvImage(image->header, image->encoding, raw),
+                                    [image](const cv_bridge::CvImage* p) { delete p; });
+}
+
+}
+
 // constructor
-ballDetector::ballDetector(const ros::NodeHandle& ng, const ros::NodeHandle& nl) : nhg(ng), nhl(nl)
+ballDetector::ballDetector(const ros::NodeHandle& nhg, const ros::NodeHandle& nhl)
 {
   // initialize communications
   image_transport::ImageTransport it(nhg);
   imageSub = it.subscribe("/image", 2, &ballDetector::imageCallback, this);
   camInfoSub = nhg.subscribe("/camera_info", 2, &ballDetector::camInfoCallback, this);
 
-  imagePub = nhg.advertise<sensor_msgs::Image>("processed_image", 1);
+  // also offers processed_image/compressed (JPEG) through the image_transport plugins
+  imagePub = it.advertise("processed_image", 1);
   bearingPub = nhg.advertise<drones::FormationLink>("bearing", 1);
+  degradationPub = nhg.advertise<std_msgs::UInt8>("detector_degradation", 1, true);
+
+  getParametersROS(nhg, nhl);
+  DetectorOptions options;
+  nhl.param("single_pass_segmentation", options.single_pass, true);
+  nhl.param("color_lut", options.color_lut, true);
+  nhl.param("roi_tracking", options.roi_tracking, true);
+  nhl.param("roi_scale", options.roi_scale, 2.0);
+  nhl.param("pipeline", options.pipeline, false);
+  nhl.param("blob_extractor", options.blob_extractor, true);
+  nhl.param("pyramid_levels", options.pyramid_levels, 0);
+  nhl.param("debug_image_scale", options.debug_image_scale, 1.0);
+  nhl.param("native_ingest", options.native_ingest, true);
+  nhl.param("frame_budget", options.frame_budget, 0.0);
+  initialize(options);
+}
 
+ballDetector::ballDetector(int drone_ID, const std::map<int, std::vector<int>>& drones_color,
+                           const DetectorOptions& options)
+{
+  // images and camera information are fed through the callbacks,
+  // bearings and debug images are not published
+  paramsROS.drone_ID = drone_ID;
+  paramsROS.num_uavs = drones_color.size() + 1;
+  paramsROS.drones_color = drones_color;
+  initialize(options);
+}
+
+void ballDetector::initialize(const DetectorOptions& options)
+{
   // initialize values
   sat_ = 130;
   val_ = 100;
   infoDetection.ballRadius = 0.09;
   infoDetection.t_ball2drone = Eigen::Vector3d(0,0,0.15);
   infoDetection.t_camera2drone = Eigen::Vector3d(0.07, 0.0, 0.055);
-  getParametersROS();
+  single_pass_ = options.single_pass;
+  use_lut_ = options.color_lut;
+  roi_tracking_ = options.roi_tracking;
+  roi_scale_ = options.roi_scale;
+  pipeline_ = options.pipeline;
+  use_blobs_ = options.blob_extractor;
+  pyramid_levels_ = options.pyramid_levels;
+  debug_image_scale_ = options.debug_image_scale;
+  native_ingest_ = options.native_ingest;
+  frameBudget.budget = options.frame_budget;
+  setTargetsHueTable();
+  filters.resize(segmentation.ids.size());
   outputMessage.drone_name = "drone" + std::to_string(paramsROS.drone_ID);
   show_segment_ = false;
   show_output_ = false;
@@ -34,50 +129,293 @@ ballDetector::ballDetector(const ros::NodeHandle& ng, const ros::NodeHandle& nl)
     cv::setTrackbarPos("Value", "Color detector - range", 95);
   }
 
+  if (pyramid_levels_ > 0 && (!single_pass_ || pipeline_))
+  {
+    ROS_WARN("Pyramid detection needs single pass segmentation and is not pipelined, disabling it");
+    pyramid_levels_ = 0;
+  }
+  pyramid_levels_ = std::min(pyramid_levels_, 2);
+
+  if (frameBudget.budget > 0 && pipeline_)
+  {
+    ROS_WARN("The frame budget only applies to the sequential detector, ignoring it");
+    frameBudget.budget = 0;
+  }
+  if (frameBudget.budget > 0 && degradationPub)
+  {
+    std_msgs::UInt8 level;
+    level.data = frameBudget.level;
+    degradationPub.publish(level);
+  }
+
+  // debug images are drawn and encoded in the background
+  pipeline.running = true;
+  pipeline.threads.emplace_back(&ballDetector::publishStage, this);
+
+  if (pipeline_)
+    startPipeline();
+
   ROS_INFO_STREAM("drone" << paramsROS.drone_ID << "Ball Detector initialized");
 }
 
+// destructor
+ballDetector::~ballDetector()
+{
+  pipeline.running = false;
+  pipeline.decodedSignal.notify();
+  pipeline.segmentedSignal.notify();
+  pipeline.detectedSignal.notify();
+  for(auto& thread : pipeline.threads)
+    thread.join();
+}
+
 void ballDetector::spinDetector()
 {
+  // every camera frame is processed exactly once
   if (img_received)
   {
+    img_received = false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
     std::vector<cv::Vec3f> circles;
-    for(auto rgb : paramsROS.drones_color)
+
+    const int n = segmentation.ids.size();
+    const double stamp = frameTime(frame->header);
+    std::vector<cv::Vec3f> targetCircles(n);
+    std::vector<bool> measures(n, false);
+
+    // tracked targets: search only around their predicted position
+    if (roi_tracking_)
+    {
+      for(int k = 0; k < n; k++)
+      {
+        cv::Rect window;
+        if (!predictSearchWindow(k, stamp, window))
+          continue;
+
+        cv::Vec3f& circle = targetCircles[k];
+        if (detectInWindow(img(window), k, circle))
+        {
+          circle[0] += window.x;
+          circle[1] += window.y;
+          measures[k] = insideWindow(circle, window);
+        }
+      }
+    }
+
+    // lost or new targets: search the whole frame, converted and filtered once for all of them
+    const int level = frameBudget.level;
+    int levels = pyramid_levels_;
+    if (level >= DEGRADE_HALF_RESOLUTION && single_pass_)
+      levels = std::max(levels, 1);
+
+    // under load, lost targets are only searched every other frame
+    const bool search = level < DEGRADE_SKIP_SEARCH || frameBudget.frames % 2 == 0;
+    if (search && levels > 0 && ingest_ == INGEST_BGR)
+      searchPyramid(measures, targetCircles, levels);
+    else if (search)
     {
-        int target_id = rgb.first;
-        colorRGB2HUE(rgb.second[0], rgb.second[1], rgb.second[2]);
+      bool segmented = false;
+      for(int k = 0; k < n; k++)
+      {
+        if (!measures[k])
+        {
+          measures[k] = detectTarget(img, k, targetCircles[k], !segmented);
+          segmented = true;
+        }
+      }
+    }
 
-        cv::Vec3f circle;
-        //bool measure = detectColorfulCirclesHUE(img, circle);
-        bool measure = process(img,circle);
+    // bearings of the last frame stay available until the next one
+    std::shared_ptr<const CameraModel> model = std::atomic_load(&camera);
+    if (!model)
+      ROS_ERROR_THROTTLE(1, "Camera information not found!");
+    outputMessage.bearings.clear();
+    outputMessage.targets.clear();
+    outputMessage.distances.clear();
+    for(int k = 0; k < n; k++)
+    {
+        int target_id = segmentation.ids[k];
+        cv::Vec3f& circle = targetCircles[k];
+        bool measure = measures[k];
 
-        kalmanFilterProcess(measure, circle, target_id);
+        kalmanFilterProcess(measure, circle, k, stamp);
 
         if (measure)
         {
-          addMeasureToOutput(target_id, circle);
+          if (model)
+            addMeasureToOutput(*model, target_id, circle);
           circles.push_back(circle);
         }
     }
 
-    for(auto circle : circles)
+    if (bearingPub)
+      bearingPub.publish(outputMessage);
+
+    if (frameBudget.budget > 0)
+      updateFrameBudget(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    queueDebugImage(frame, circles);
+  }
+}
+
+void ballDetector::queueDebugImage(const cv_bridge::CvImageConstPtr& image, std::vector<cv::Vec3f>& circles)
+{
+  // nothing is drawn, converted or serialized without subscribers
+  if (imagePub.getNumSubscribers() == 0)
+  {
+    circles.clear();
+    return;
+  }
+
+  // dropped rather than delaying the detection when the publish stage is behind
+  PipelineFramePtr debug(new PipelineFrame);
+  debug->image = image;
+  debug->circles.swap(circles);
+  if (pipeline.detected.push(std::move(debug)))
+    pipeline.detectedSignal.notify();
+}
+
+void ballDetector::publishDebugImage(const cv::Mat& bgr, const std::vector<cv::Vec3f>& circles,
+                                     const std_msgs::Header& header)
+{
+  // bgr shares the message buffer: draw on the converted copy only
+  const double s = debug_image_scale_;
+  if (s < 1.0)
+  {
+    cv::resize(bgr, img_processed, cv::Size(), s, s, cv::INTER_AREA);
+    cv::cvtColor(img_processed, img_processed, cv::COLOR_BGR2RGB);
+  }
+  else
+    cv::cvtColor(bgr, img_processed, cv::COLOR_BGR2RGB);
+
+  for(auto circle : circles)
+  {
+    cv::Point center(std::round(s * circle[0]), std::round(s * circle[1]));
+    int radius = std::round(s * circle[2]);
+    cv::circle(img_processed, center, radius, cv::Scalar(148, 28, 248), 2);
+  }
+
+  imagePub.publish(cv_bridge::CvImage(header, "rgb8", img_processed).toImageMsg());
+}
+
+void ballDetector::startPipeline()
+{
+  if (!single_pass_)
+  {
+    ROS_WARN("The pipelined detector needs single pass segmentation, enabling it");
+    single_pass_ = true;
+    setTargetsHueTable();
+  }
+
+  pipeline.threads.emplace_back(&ballDetector::segmentStage, this);
+  pipeline.threads.emplace_back(&ballDetector::contourStage, this);
+}
+
+void ballDetector::segmentStage()
+{
+  while (pipeline.running)
+  {
+    PipelineFramePtr frame = pipeline.decoded.take();
+    if (!frame)
     {
-      cv::Point center(std::round(circle[0]), std::round(circle[1]));
-      int radius = std::round(circle[2]);
-      cv::circle(img, center, radius, cv::Scalar(248, 28, 148), 2);
+      pipeline.decodedSignal.wait(std::chrono::milliseconds(100));
+      continue;
     }
-    circles.clear();
 
-    cv::cvtColor(img, img_processed, cv::COLOR_BGR2RGB);
-    imagePub.publish(cv_bridge::CvImage(std_msgs::Header(), "rgb8", img_processed).toImageMsg());
-    bearingPub.publish(outputMessage);
+    // the masks are handed over with the frame, the next frame gets new ones
+    const cv::Mat& image = frame->image->image;
+    Ingest ingest = ingestOf(frame->image->encoding);
+    if (ingest == INGEST_NV12 || ingest == INGEST_NV21)
+      segmentTargets(image.rowRange(0, image.rows * 2 / 3), ingest, image.rowRange(image.rows * 2 / 3, image.rows).reshape(2));
+    else
+      segmentTargets(image, ingest);
+    frame->masks.resize(segmentation.masks.size());
+    frame->masks.swap(segmentation.masks);
+
+    pipeline.segmented.put(std::move(frame));
+    pipeline.segmentedSignal.notify();
+  }
+}
+
+void ballDetector::contourStage()
+{
+  while (pipeline.running)
+  {
+    PipelineFramePtr frame = pipeline.segmented.take();
+    if (!frame)
+    {
+      pipeline.segmentedSignal.wait(std::chrono::milliseconds(100));
+      continue;
+    }
+
+    // contours of all targets in parallel, filters and output in order
+    const int n = frame->masks.size();
+    std::vector<cv::Vec3f> targetCircles(n);
+    std::vector<uchar> measures(n);
+    parallelFor(cv::Range(0, n), [&](const cv::Range& range)
+    {
+      for(int k = range.start; k < range.end; k++)
+        measures[k] = processMask(frame->masks[k], k, targetCircles[k]);
+    });
+
+    // one camera model for the whole frame, camInfoCallback may swap it meanwhile
+    std::shared_ptr<const CameraModel> model = std::atomic_load(&camera);
+    if (!model)
+      ROS_ERROR_THROTTLE(1, "Camera information not found!");
+
+    const double stamp = frameTime(frame->image->header);
     outputMessage.bearings.clear();
     outputMessage.targets.clear();
     outputMessage.distances.clear();
+    for(int k = 0; k < n; k++)
+    {
+      int target_id = segmentation.ids[k];
+      kalmanFilterProcess(measures[k], targetCircles[k], k, stamp);
+
+      if (measures[k])
+      {
+        if (model)
+          addMeasureToOutput(*model, target_id, targetCircles[k]);
+        frame->circles.push_back(targetCircles[k]);
+      }
+    }
+
+    if (bearingPub)
+      bearingPub.publish(outputMessage);
+
+    queueDebugImage(frame->image, frame->circles);
   }
 }
 
-void ballDetector::colorRGB2HUE(int r, int g, int b)
+void ballDetector::publishStage()
+{
+  while (pipeline.running)
+  {
+    PipelineFramePtr frame;
+    if (!pipeline.detected.pop(frame))
+    {
+      pipeline.detectedSignal.wait(std::chrono::milliseconds(100));
+      continue;
+    }
+
+    if (imagePub.getNumSubscribers() == 0)
+      continue;
+
+    // native frames are converted for display only
+    const cv_bridge::CvImageConstPtr& image = frame->image;
+    int conversion = debugConversion(image->encoding);
+    if (conversion >= 0)
+    {
+      cv::cvtColor(image->image, img_debug, conversion);
+      publishDebugImage(img_debug, frame->circles, image->header);
+    }
+    else
+      publishDebugImage(image->image, frame->circles, image->header);
+  }
+}
+
+int ballDetector::colorRGB2HUE(int r, int g, int b)
 {
   hue_.clear();
   // convert color to HSV
@@ -111,6 +449,8 @@ void ballDetector::colorRGB2HUE(int r, int g, int b)
     hue_.push_back(0);
     hue_.push_back(h + hthr - 179);
   }
+
+  return h;
 }
 
 void ballDetector::imgBGRtoimgHUE(cv::Mat& img)
@@ -161,39 +501,7 @@ std::vector<cv::Point> ballDetector::findMainContour(const cv::Mat &_im)
             cv::waitKey(1);
         }
 
-        std::vector<std::vector<cv::Point> > contours;
-        std::vector<cv::Vec4i> hierarchy;
-        cv::findContours( seg1_, contours, hierarchy, CV_RETR_CCOMP,
-                          CV_CHAIN_APPROX_SIMPLE);
-
-        // pop all children
-        bool found = true;
-        while(found)
-        {
-            found = false;
-            for(unsigned int i=0;i<hierarchy.size();++i)
-            {
-                if(hierarchy[i][3] > -1)
-                {
-                    found = true;
-                    hierarchy.erase(hierarchy.begin()+i,hierarchy.begin()+i+1);
-                    contours.erase(contours.begin()+i, contours.begin()+i+1);
-                    break;
-                }
-            }
-        }
-
-        if(contours.size())
-        {
-            // get largest contour
-            auto largest = std::max_element(
-                        contours.begin(), contours.end(),
-                        [](const std::vector<cv::Point> &c1, const std::vector<cv::Point> &c2)
-            {return cv::contourArea(c1) < cv::contourArea(c2);});
-            int idx = std::distance(contours.begin(), largest);
-
-            return contours[idx];
-        }
+        return findMainContourInMask(seg1_);
     }
     else
     {
@@ -203,10 +511,71 @@ std::vector<cv::Point> ballDetector::findMainContour(const cv::Mat &_im)
     return std::vector<cv::Point>();
 }
 
+std::vector<cv::Point> ballDetector::findMainContourInMask(cv::Mat& mask)
+{
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<cv::Vec4i> hierarchy;
+    cv::findContours( mask, contours, hierarchy, CV_RETR_CCOMP,
+                      CV_CHAIN_APPROX_SIMPLE);
+
+    // largest outer contour, children (holes) are skipped
+    int idx = -1;
+    double largest = 0;
+    for(unsigned int i=0;i<contours.size();++i)
+    {
+        if(hierarchy[i][3] > -1)
+            continue;
+
+        double area = cv::contourArea(contours[i]);
+        if(idx < 0 || area > largest)
+        {
+            idx = i;
+            largest = area;
+        }
+    }
+
+    if(idx >= 0)
+        return contours[idx];
+
+    return std::vector<cv::Point>();
+}
+
 bool ballDetector::process(const cv::Mat &_im, cv::Vec3f& circle, bool write_output)
 {
-    auto contour = findMainContour(_im);
+    return circleFromContour(findMainContour(_im), circle);
+}
+
+bool ballDetector::processMask(cv::Mat& mask, const int& k, cv::Vec3f& circle, float min_radius)
+{
+    stageProfiler::Scope contour(profiler, stageProfiler::CONTOUR);
+    if(use_blobs_)
+        return circleFromBlobs(segmentation.extractors[k].extract(mask), circle, min_radius);
 
+    return circleFromContour(findMainContourInMask(mask), circle, min_radius);
+}
+
+bool ballDetector::circleFromBlobs(const std::vector<Blob>& blobs, cv::Vec3f& circle, float min_radius)
+{
+    // largest blob filling enough of its enclosing circle, same test as circleFromContour
+    const Blob* best = nullptr;
+    for(const Blob& blob : blobs)
+    {
+        float radius = 0.5f * (std::max(blob.box.width, blob.box.height) - 1);
+        if(radius > min_radius && blob.area > 0.5*M_PI*pow(radius,2) && (!best || blob.area > best->area))
+            best = &blob;
+    }
+
+    if(!best)
+        return false;
+
+    circle[0] = best->box.x + 0.5f * (best->box.width - 1);
+    circle[1] = best->box.y + 0.5f * (best->box.height - 1);
+    circle[2] = 0.5f * (std::max(best->box.width, best->box.height) - 1);
+    return true;
+}
+
+bool ballDetector::circleFromContour(const std::vector<cv::Point>& contour, cv::Vec3f& circle, float min_radius)
+{
     if(!contour.size())
     {
         return false;
@@ -216,7 +585,7 @@ bool ballDetector::process(const cv::Mat &_im, cv::Vec3f& circle, bool write_out
     cv::minEnclosingCircle(contour, pt, radius);
 
     double area = cv::contourArea(contour);
-    if(area > 0.5*M_PI*pow(radius,2) && radius > 10.0)
+    if(area > 0.5*M_PI*pow(radius,2) && radius > min_radius)
     {
       circle[0] = pt.x;
       circle[1] = pt.y;
@@ -229,6 +598,207 @@ bool ballDetector::process(const cv::Mat &_im, cv::Vec3f& circle, bool write_out
     }
 }
 
+void ballDetector::setTargetsHueTable()
+{
+  segmentation.ids.clear();
+  segmentation.masks.clear();
+  segmentation.window.masks.clear();
+  segmentation.targets.clear();
+  segmentation.extractors.clear();
+  segmentation.hueBits.assign(180, 0);
+
+  for(auto rgb : paramsROS.drones_color)
+  {
+    int k = segmentation.ids.size();
+    int h = colorRGB2HUE(rgb.second[0], rgb.second[1], rgb.second[2]);
+
+    // hue_ holds one or two [min, max] ranges (red wraps around)
+    if (k < 32)
+      for(unsigned int i = 0; i + 1 < hue_.size(); i += 2)
+        for(int hue = hue_[i]; hue <= hue_[i+1]; hue++)
+          segmentation.hueBits[hue] |= 1u << k;
+
+    segmentation.targets.push_back({h, hue_});
+    segmentation.ids.push_back(rgb.first);
+    segmentation.masks.push_back(cv::Mat());
+    segmentation.window.masks.push_back(cv::Mat());
+    segmentation.extractors.push_back(blobExtractor());
+  }
+
+  if (segmentation.ids.size() > 32 && !use_lut_)
+  {
+    ROS_WARN("Single pass HSV segmentation handles at most 32 targets, falling back to one pass per target");
+    single_pass_ = false;
+  }
+}
+
+void ballDetector::segmentTargets(const cv::Mat& _im, Ingest ingest, const cv::Mat& chroma)
+{
+  if (use_lut_)
+  {
+    // thresholds may have been changed through the trackbars
+    colorLUT::Space space = (ingest >= INGEST_YUYV && ingest <= INGEST_NV21) ? colorLUT::YUV : colorLUT::BGR;
+    if (lut.needsRebuild(sat_, val_, space))
+      lut.build(segmentation.targets, sat_, val_, space);
+
+    // the masks come out of the same pass, segmentation included in conversion
+    stageProfiler::Scope convert(profiler, stageProfiler::CONVERT);
+    classifyTargets(_im, ingest, chroma, false, segmentation.labels, segmentation.masks);
+    return;
+  }
+
+  cv::Mat& hsv = segmentation.hsv;
+  {
+    stageProfiler::Scope convert(profiler, stageProfiler::CONVERT);
+    cv::cvtColor(_im, hsv, cv::COLOR_BGR2HSV);
+    if (frameBudget.level < DEGRADE_NO_BLUR)
+      cv::GaussianBlur(hsv, hsv, cv::Size(11,11), 2);
+  }
+
+  stageProfiler::Scope segment(profiler, stageProfiler::SEGMENT);
+
+  for(auto& mask : segmentation.masks)
+  {
+    mask.create(hsv.size(), CV_8UC1);
+    mask.setTo(0);
+  }
+
+  // classify every pixel against all targets: same bounds as the inRange of findMainContour
+  std::vector<uchar*> rows(segmentation.masks.size());
+  for(int y = 0; y < hsv.rows; y++)
+  {
+    for(unsigned int k = 0; k < rows.size(); k++)
+      rows[k] = segmentation.masks[k].ptr<uchar>(y);
+
+    const uchar* px = hsv.ptr<uchar>(y);
+    for(int x = 0; x < hsv.cols; x++, px += 3)
+    {
+      if (px[1] < sat_ || px[2] < val_)
+        continue;
+
+      uint32_t bits = segmentation.hueBits[px[0]];
+      while (bits)
+      {
+        rows[__builtin_ctz(bits)][x] = 255;
+        bits &= bits - 1;
+      }
+    }
+  }
+}
+
+cv::Mat ballDetector::grownView(cv::Mat& buffer, cv::Size size, int type)
+{
+  if (buffer.type() != type || buffer.cols < size.width || buffer.rows < size.height)
+    buffer.create(std::max(buffer.rows, size.height), std::max(buffer.cols, size.width), type);
+  return buffer(cv::Rect(cv::Point(), size));
+}
+
+cv::Mat ballDetector::segmentWindow(const cv::Mat& _im, int k, Ingest ingest, const cv::Mat& chroma)
+{
+  // only target k, so the cost follows the window area and not the number of targets
+  auto& window = segmentation.window;
+  if (use_lut_)
+  {
+    colorLUT::Space space = (ingest >= INGEST_YUYV && ingest <= INGEST_NV21) ? colorLUT::YUV : colorLUT::BGR;
+    if (lut.needsRebuild(sat_, val_, space))
+      lut.build(segmentation.targets, sat_, val_, space);
+
+    stageProfiler::Scope convert(profiler, stageProfiler::CONVERT);
+    // label image size of the ingest: pixel pairs and Bayer quads are whole
+    cv::Size size = _im.size();
+    if (ingest == INGEST_YUYV || ingest == INGEST_UYVY)
+      size.width = 2 * _im.reshape(4).cols;
+    else if (ingest > INGEST_NV21)
+      size = cv::Size(_im.cols / 2 * 2, _im.rows / 2 * 2);
+    cv::Mat labels = grownView(window.labels, size, CV_8UC1);
+    classifyTargets(_im, ingest, chroma, true, labels, window.none);
+    cv::Mat mask = grownView(window.masks[k], labels.size(), CV_8UC1);
+    cv::compare(labels, (double)(k + 1), mask, cv::CMP_EQ);
+    return mask;
+  }
+
+  cv::Mat hsv = grownView(window.hsv, _im.size(), CV_8UC3);
+  {
+    stageProfiler::Scope convert(profiler, stageProfiler::CONVERT);
+    cv::cvtColor(_im, hsv, cv::COLOR_BGR2HSV);
+    if (frameBudget.level < DEGRADE_NO_BLUR)
+      cv::GaussianBlur(hsv, hsv, cv::Size(11,11), 2);
+  }
+
+  stageProfiler::Scope segment(profiler, stageProfiler::SEGMENT);
+  cv::Mat mask = grownView(window.masks[k], hsv.size(), CV_8UC1);
+  const uint32_t bit = 1u << k;
+  for(int y = 0; y < hsv.rows; y++)
+  {
+    const uchar* px = hsv.ptr<uchar>(y);
+    uchar* row = mask.ptr<uchar>(y);
+    for(int x = 0; x < hsv.cols; x++, px += 3)
+      row[x] = (px[1] >= sat_ && px[2] >= val_ && (segmentation.hueBits[px[0]] & bit)) ? 255 : 0;
+  }
+  return mask;
+}
+
+void ballDetector::classifyTargets(const cv::Mat& _im, Ingest ingest, const cv::Mat& chroma, bool window,
+                                   cv::Mat& labels, std::vector<cv::Mat>& masks)
+{
+  // each channel blurred at its own resolution, as much as the bgr8 image would be,
+  // not at all when degraded (buffers never alias the frame: it may be the message)
+  const bool blur = frameBudget.level < DEGRADE_NO_BLUR;
+  auto smooth = [blur, window](const cv::Mat& src, cv::Mat& buffer, cv::Size size, double sigmaX, double sigmaY)
+  {
+    if (!blur)
+      return src;
+    if (window)
+    {
+      cv::Mat view = grownView(buffer, src.size(), src.type());
+      cv::GaussianBlur(src, view, size, sigmaX, sigmaY);
+      return view;
+    }
+    cv::GaussianBlur(src, buffer, size, sigmaX, sigmaY);
+    return buffer;
+  };
+  cv::Mat& blurred = window ? segmentation.window.blurred : segmentation.blurred;
+  cv::Mat& blurred2 = window ? segmentation.window.blurred2 : segmentation.blurred2;
+  switch (ingest)
+  {
+    case INGEST_BGR:
+      lut.classify(smooth(_im, blurred, cv::Size(11,11), 2, 2), labels, masks);
+      break;
+
+    case INGEST_YUYV:
+    case INGEST_UYVY:
+      // pixel pairs share their chroma
+      lut.classifyYUV422(smooth(_im.reshape(4), blurred, cv::Size(5,11), 1, 2), ingest == INGEST_UYVY,
+                         labels, masks);
+      break;
+
+    case INGEST_NV12:
+    case INGEST_NV21:
+    {
+      // _im may be a window of the luma plane: same window in the chroma plane
+      cv::Size whole;
+      cv::Point offset;
+      _im.locateROI(whole, offset);
+      cv::Rect window(offset.x / 2, offset.y / 2, (_im.cols + 1) / 2, (_im.rows + 1) / 2);
+      lut.classifyYUV420(smooth(_im, blurred, cv::Size(11,11), 2, 2),
+                         smooth(chroma(window), blurred2, cv::Size(5,5), 1, 1),
+                         ingest == INGEST_NV21, labels, masks);
+      break;
+    }
+
+    default:
+    {
+      // Bayer mosaic: even and odd rows as half resolution two channel images
+      cv::Mat top(_im.rows / 2, _im.cols / 2, CV_8UC2, const_cast<uchar*>(_im.data), 2 * _im.step);
+      cv::Mat bottom(_im.rows / 2, _im.cols / 2, CV_8UC2, const_cast<uchar*>(_im.data) + _im.step, 2 * _im.step);
+      static const int red[] = {0, 1, 2, 3}; // RGGB, GRBG, GBRG, BGGR
+      lut.classifyBayer(smooth(top, blurred, cv::Size(5,5), 1, 1), smooth(bottom, blurred2, cv::Size(5,5), 1, 1),
+                        red[ingest - INGEST_BAYER_RGGB], labels, masks);
+      break;
+    }
+  }
+}
+
 bool ballDetector::detectColorfulCirclesHUE(cv::Mat& img,
                                               cv::Vec3f& circle,
                                               bool write_circle)
@@ -314,99 +884,191 @@ bool ballDetector::bestRadiusEstimation(double& radius,
   return false;
 }
 
-void ballDetector::kalmanFilterProcess(const bool measure,
-                                         cv::Vec3f& circle,
-                                         const int& uav_detected_id )
+bool ballDetector::detectTarget(const cv::Mat& _im, const int& k, cv::Vec3f& circle, bool segment)
 {
-  KalmanFilterPtr KF;
+  if (single_pass_)
+  {
+    if (segment)
+      segmentTargets(_im, ingest_, img_chroma);
+    return processMask(segmentation.masks[k], k, circle);
+  }
+
+  const std::vector<int>& rgb = paramsROS.drones_color[segmentation.ids[k]];
+  colorRGB2HUE(rgb[0], rgb[1], rgb[2]);
+  //return detectColorfulCirclesHUE(_im, circle);
+  stageProfiler::Scope contour(profiler, stageProfiler::CONTOUR); // conversion included
+  return process(_im, circle);
+}
+
+bool ballDetector::detectInWindow(const cv::Mat& _im, const int& k, cv::Vec3f& circle)
+{
+  if (!single_pass_)
+    return detectTarget(_im, k, circle);
+
+  cv::Mat mask = segmentWindow(_im, k, ingest_, img_chroma);
+  return processMask(mask, k, circle);
+}
+
+void ballDetector::searchPyramid(std::vector<bool>& measures, std::vector<cv::Vec3f>& circles, int levels)
+{
+  const int n = segmentation.ids.size();
+  const int scale = 1 << levels;
+
+  // coarse: candidate of each target in the downscaled frame
+  cv::resize(img, img_small, cv::Size(img.cols / scale, img.rows / scale), 0, 0, cv::INTER_AREA);
+  segmentTargets(img_small);
+
+  std::vector<cv::Rect> windows(n);
+  for(int k = 0; k < n; k++)
+  {
+    cv::Vec3f coarse;
+    if (measures[k] || !processMask(segmentation.masks[k], k, coarse, 10.0f / scale))
+      continue;
+
+    // margin for the blur and the quantization of the coarse level
+    float half = scale * (coarse[2] + 2);
+    windows[k] = cv::Rect(std::round(scale * coarse[0] - half), std::round(scale * coarse[1] - half),
+                          std::round(2 * half), std::round(2 * half));
+    windows[k] &= cv::Rect(0, 0, img.cols, img.rows);
+  }
 
-  if(getKalmanFilterStructure(KF, measure, uav_detected_id))
+  // fine: enclosing circle at full resolution inside each candidate window
+  for(int k = 0; k < n; k++)
   {
-    double dT;
-    KF->last_estimation = KF->current_estimation;
-    KF->current_estimation = ros::Time::now().toSec();
-    dT = KF->current_estimation - KF->last_estimation;
+    const cv::Rect& window = windows[k];
+    if (window.area() == 0)
+      continue;
 
-    if(KF->found)
+    cv::Mat mask = segmentWindow(img(window), k);
+    cv::Vec3f& circle = circles[k];
+    if (circleFromContour(findMainContourInMask(mask), circle))
     {
-      KF->kf.transitionMatrix.at<float>(3) = dT;
-      KF->kf.transitionMatrix.at<float>(9) = dT;
-      KF->state = KF->kf.predict();
+      circle[0] += window.x;
+      circle[1] += window.y;
+      measures[k] = true;
     }
+  }
+}
+
+bool ballDetector::predictSearchWindow(const int& k, const double& stamp, cv::Rect& window)
+{
+  if (!filters.active(k) || filters.filter(k).missed)
+    return false;
+
+  // a priori state and covariance at the frame time, without touching the filter
+  const TargetFilterBank::State x = filters.predicted(k, stamp);
+  const TargetFilterBank::StateCov P = filters.predictedCov(k, stamp);
+
+  float sigma_xy = std::sqrt(std::max(P(0, 0), P(1, 1)));
+  float sigma_r = std::sqrt(P(2, 2));
+  double scale = roi_scale_;
+  if (frameBudget.level >= DEGRADE_NARROW_ROI)
+    scale = std::min(roi_scale_, std::max(1.2, 0.6 * roi_scale_));
+  float half = scale * (x(2) + 3 * sigma_r) + 3 * sigma_xy;
+
+  window = cv::Rect(std::round(x(0) - half), std::round(x(1) - half),
+                    std::round(2 * half), std::round(2 * half));
+  window &= cv::Rect(0, 0, img.cols, img.rows);
+
+  // chroma samples and Bayer quads start on even pixels
+  if (ingest_ != INGEST_BGR)
+  {
+    int x0 = window.x & ~1, y0 = window.y & ~1;
+    int x1 = std::min((window.br().x + 1) & ~1, img.cols), y1 = std::min((window.br().y + 1) & ~1, img.rows);
+    window = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+  }
+
+  return window.area() > 0;
+}
+
+bool ballDetector::insideWindow(const cv::Vec3f& circle, const cv::Rect& window)
+{
+  // a circle touching a side of the window that lies inside the image may be cut by it
+  return (window.x == 0 || circle[0] - circle[2] > window.x + 1) &&
+         (window.y == 0 || circle[1] - circle[2] > window.y + 1) &&
+         (window.br().x == img.cols || circle[0] + circle[2] < window.br().x - 1) &&
+         (window.br().y == img.rows || circle[1] + circle[2] < window.br().y - 1);
+}
+
+void ballDetector::kalmanFilterProcess(const bool measure,
+                                       cv::Vec3f& circle,
+                                       const int& k,
+                                       const double& stamp)
+{
+  stageProfiler::Scope kalman(profiler, stageProfiler::KALMAN);
+  const TargetFilterBank::Measure z(circle[0], circle[1], circle[2]);
+
+  if (!filters.active(k))
+  {
+    if (!measure)
+      return;
+    filters.init(k, z, stamp); // First detection!
+  }
+  else
+  {
+    filters.predict(k, stamp);
 
     if (!measure)
     {
-      if (ros::Time::now().toSec() - KF->last_measure > 3.0)
-        measuresKF.erase(uav_detected_id);
+      filters.missedMeasure(k);
+      if (stamp - filters.filter(k).last_measure > 3.0)
+        filters.reset(k);
     }
     else
-    {
-      KF->last_measure = ros::Time::now().toSec();
-
-      KF->meas.at<float>(0) = circle[0];
-      KF->meas.at<float>(1) = circle[1];
-      KF->meas.at<float>(2) = circle[2];
-
-      if (!KF->found) // First detection!
-      {
-        // Initialization
-        KF->kf.errorCovPre.at<float>(0) = 0.01;
-        KF->kf.errorCovPre.at<float>(6) = 0.01;
-        KF->kf.errorCovPre.at<float>(12) = 0.01;
-        KF->kf.errorCovPre.at<float>(18) = 0.001;
-        KF->kf.errorCovPre.at<float>(24) = 0.001;
-
-        KF->state.at<float>(0) = KF->meas.at<float>(0);
-        KF->state.at<float>(1) = KF->meas.at<float>(1);
-        KF->state.at<float>(2) = KF->meas.at<float>(2);
-        KF->state.at<float>(3) = 0;
-        KF->state.at<float>(4) = 0;
-
-        KF->kf.statePost = KF->state;
-
-        KF->found = true;
-      }
-      else
-        KF->kf.correct(KF->meas); // Kalman Correction
-    }
-
-    circle[0] = KF->state.at<float>(0);
-    circle[1] = KF->state.at<float>(1);
-    circle[2] = KF->state.at<float>(2);
+      filters.correct(k, z); // Kalman Correction
   }
 
+  const TargetFilterBank::State& x = filters.filter(k).x;
+  circle[0] = x(0);
+  circle[1] = x(1);
+  circle[2] = x(2);
 }
 
-bool ballDetector::getKalmanFilterStructure(KalmanFilterPtr& KFPtr,
-                                            const bool measure,
-                                            const int& uav_detected_id)
+void ballDetector::updateFrameBudget(double seconds)
 {
-  std::map<int, KalmanFilterPtr>::iterator it = measuresKF.find(uav_detected_id);
-
-  if (it == measuresKF.end())
+  FrameBudget& fb = frameBudget;
+  fb.frames++;
+  fb.hold++;
+  fb.cost = fb.cost > 0 ? 0.8 * fb.cost + 0.2 * seconds : seconds;
+
+  // degrade as soon as the cost settles above the budget, recover only with a clear margin
+  int level = fb.level;
+  if (fb.cost > fb.budget && fb.hold >= 5 && level + 1 < DEGRADE_LEVELS)
+    level++;
+  else if (fb.cost < 0.5 * fb.budget && fb.hold >= 30 && level > DEGRADE_NONE)
+    level--;
+  if (level == fb.level)
+    return;
+
+  ROS_INFO("Detector degradation level %d (frame cost %.1f ms, budget %.1f ms)",
+           level, 1e3 * fb.cost, 1e3 * fb.budget);
+  fb.level = level;
+  fb.hold = 0;
+  fb.cost = 0;
+
+  if (degradationPub)
   {
-    if(measure)
-      measuresKF[uav_detected_id] = std::make_shared<KalmanFilter>();
-    else
-      return false;
+    std_msgs::UInt8 message;
+    message.data = level;
+    degradationPub.publish(message);
   }
+}
 
-  KFPtr =  measuresKF[uav_detected_id];
-  return true;
+double ballDetector::frameTime(const std_msgs::Header& header)
+{
+  // cameras that do not stamp their images fall back to the reception time
+  return header.stamp.isZero() ? ros::Time::now().toSec() : header.stamp.toSec();
 }
 
-bool ballDetector::addMeasureToOutput(const int& target_id, const cv::Vec3f& circle)
+bool ballDetector::addMeasureToOutput(const CameraModel& camera, const int& target_id, const cv::Vec3f& circle)
 {
-  if (!camInfo.received) { ROS_ERROR("Camera information not found!"); return false; }
+  stageProfiler::Scope output(profiler, stageProfiler::OUTPUT);
 
   outputMessage.targets.push_back( "drone" + std::to_string(target_id) );
-  double distance = camInfo.K(0, 0) * infoDetection.ballRadius / circle[2];
-
-  Eigen::Vector3d P;
-  P << circle[0], circle[1], 1;
+  double distance = camera.K(0, 0) * infoDetection.ballRadius / circle[2];
 
-  Eigen::Vector3d bearingRaw;
-  bearingRaw = camInfo.R * camInfo.K.inverse() * P;
+  // ray of the ball center, undistorted and in the drone frame
+  Eigen::Vector3d bearingRaw = camera.rays.ray(circle[0], circle[1]);
 
   // Transformation from ball frame to drone frame
   Eigen::Vector3d bearing = bearingRaw * distance - infoDetection.t_ball2drone;
@@ -429,7 +1091,7 @@ bool ballDetector::addMeasureToOutput(const int& target_id, const cv::Vec3f& cir
   return true;
 }
 
-void ballDetector::getParametersROS()
+void ballDetector::getParametersROS(const ros::NodeHandle& nhg, const ros::NodeHandle& nhl)
 {
   if (nhl.getParam("uav_id", paramsROS.drone_ID) && nhg.getParam("/uavs_info/num_uavs", paramsROS.num_uavs))
   {
@@ -455,36 +1117,103 @@ void ballDetector::getParametersROS()
   }
 }
 
+Ingest ballDetector::ingestOf(const std::string& encoding) const
+{
+  // native encodings go through the color table only
+  if (!native_ingest_ || !single_pass_ || !use_lut_)
+    return INGEST_BGR;
+
+  for(const NativeEncoding& native : nativeEncodings)
+    if (encoding == native.encoding)
+      return native.ingest;
+  return INGEST_BGR;
+}
+
 // callback functions
 
 void ballDetector::camInfoCallback(const sensor_msgs::CameraInfo& _camInfo)
 {
-  camInfo.K <<  _camInfo.K[0], _camInfo.K[1], _camInfo.K[2],
-                _camInfo.K[3], _camInfo.K[4], _camInfo.K[5],
-                _camInfo.K[6], _camInfo.K[7], _camInfo.K[8];
-
-  camInfo.R << 0, 0, 1,
-              -1, 0, 0,
-              0, -1, 0;
-
-  camInfo.width = _camInfo.width;
-  camInfo.height = _camInfo.height;
+  // zeroed or uncalibrated camera information, the previous model is kept
+  if (_camInfo.width < 2 || _camInfo.height < 2 || _camInfo.K[0] <= 0)
+  {
+    ROS_ERROR_THROTTLE(1, "Invalid camera information (%ux%u, fx %g) ignored",
+                       _camInfo.width, _camInfo.height, _camInfo.K[0]);
+    return;
+  }
 
-  camInfo.received = true;
+  Eigen::Matrix3d R;
+  R << 0, 0, 1,
+      -1, 0, 0,
+       0, -1, 0;
+
+  // only rebuilt when the camera changes
+  std::shared_ptr<const CameraModel> current = std::atomic_load(&camera);
+  if (current && current->rays.matches(_camInfo, R))
+    return;
+
+  std::shared_ptr<CameraModel> model = std::make_shared<CameraModel>();
+  model->K <<  _camInfo.K[0], _camInfo.K[1], _camInfo.K[2],
+               _camInfo.K[3], _camInfo.K[4], _camInfo.K[5],
+               _camInfo.K[6], _camInfo.K[7], _camInfo.K[8];
+  model->R = R;
+  model->width = _camInfo.width;
+  model->height = _camInfo.height;
+  model->rays.build(_camInfo, R);
+
+  std::atomic_store(&camera, std::shared_ptr<const CameraModel>(model));
 }
 
 void ballDetector::imageCallback(const sensor_msgs::ImageConstPtr& image)
 {
+  // skip frames already received (e.g. delivered twice through remaps)
+  if (frame && image->header.seq == frame_seq && image->header.stamp == frame_stamp)
+    return;
+
   try
   {
-    img = cv_bridge::toCvCopy(image, "bgr8")->image;
+    // no copy when the camera already publishes bgr8 or an encoding segmented as is
+    ingest_ = ingestOf(image->encoding);
+    if (ingest_ != INGEST_BGR)
+    {
+      frame = nativeImage(image, ingest_);
+      img = frame->image;
+      if (ingest_ == INGEST_NV12 || ingest_ == INGEST_NV21)
+      {
+        img = frame->image.rowRange(0, image->height);
+        img_chroma = frame->image.rowRange(image->height, frame->image.rows).reshape(2);
+      }
+    }
+    else
+    {
+      frame = cv_bridge::toCvShare(image, "bgr8");
+      img = frame->image;
+    }
+    frame_seq = image->header.seq;
+    frame_stamp = image->header.stamp;
     if (!img.empty())
       img_received = true;
   }
   catch (cv_bridge::Exception& e)
   {
     ROS_ERROR("Could not convert from '%s' to 'bgr8'.", image->encoding.c_str());
+    return;
+  }
+
+  if (pipeline_)
+  {
+    // latest frame wins when the segmentation stage is busy
+    if (img_received)
+    {
+      PipelineFramePtr decoded(new PipelineFrame);
+      decoded->image = frame;
+      pipeline.decoded.put(std::move(decoded));
+      pipeline.decodedSignal.notify();
+      img_received = false;
+    }
+    return;
   }
+
+  spinDetector();
 }
 
 }
@@ -0,0 +1,400 @@
+#include "ball_detector.h"
+#include "synthetic_camera.h"
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <opencv2/imgcodecs.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Offline throughput of the ball detector: runs the detection stages on a
+// folder of images, on the images of a bag or on rendered frames, without
+// roscore. Rendered frames also give the error of the bearings.
+//
+//   ball_detector_benchmark <images folder | file.bag> --params config/params.yaml
+//       [--uav_id 1] [--camera calibration.yaml] [--image_topic /image]
+//       [--camera_info_topic /camera_info] [--rate 30] [--repeat 1] [--warmup 10]
+//       [--no_color_lut] [--no_single_pass] [--no_roi_tracking] [--roi_scale 2]
+//       [--contours] [--pyramid_levels 0] [--no_native_ingest] [--frame_budget 0]
+//
+//   ball_detector_benchmark --synthetic <frames> (--params params.yaml | --targets 20)
+//       [--width 640] [--height 480] [--noise 0] [--blur 0] [--clutter 0] [--seed 1]
+//       and the options above
+
+// heap allocations of the whole process, per frame differences are reported
+static std::atomic<long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+
+struct BenchmarkArgs
+{
+  std::string input, params, camera;
+  std::string image_topic = "/image", camera_info_topic = "/camera_info";
+  int uav_id = 1;
+  double rate = 30;
+  int repeat = 1;
+  int warmup = 10;
+  int synthetic = 0, targets = 0;
+  int width = 640, height = 480;
+  rosdrone_Detector::RendererOptions renderer;
+  rosdrone_Detector::DetectorOptions options; // the profiler follows the sequential detector only
+};
+
+bool parseArgs(int argc, char** argv, BenchmarkArgs& args)
+{
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool value = i + 1 < argc;
+    if (arg == "--params" && value) args.params = argv[++i];
+    else if (arg == "--camera" && value) args.camera = argv[++i];
+    else if (arg == "--image_topic" && value) args.image_topic = argv[++i];
+    else if (arg == "--camera_info_topic" && value) args.camera_info_topic = argv[++i];
+    else if (arg == "--uav_id" && value) args.uav_id = std::atoi(argv[++i]);
+    else if (arg == "--rate" && value) args.rate = std::atof(argv[++i]);
+    else if (arg == "--repeat" && value) args.repeat = std::atoi(argv[++i]);
+    else if (arg == "--warmup" && value) args.warmup = std::atoi(argv[++i]);
+    else if (arg == "--roi_scale" && value) args.options.roi_scale = std::atof(argv[++i]);
+    else if (arg == "--pyramid_levels" && value) args.options.pyramid_levels = std::atoi(argv[++i]);
+    else if (arg == "--synthetic" && value) args.synthetic = std::atoi(argv[++i]);
+    else if (arg == "--targets" && value) args.targets = std::atoi(argv[++i]);
+    else if (arg == "--width" && value) args.width = std::atoi(argv[++i]);
+    else if (arg == "--height" && value) args.height = std::atoi(argv[++i]);
+    else if (arg == "--noise" && value) args.renderer.noise = std::atof(argv[++i]);
+    else if (arg == "--blur" && value) args.renderer.blur = std::atof(argv[++i]);
+    else if (arg == "--clutter" && value) args.renderer.clutter = std::atoi(argv[++i]);
+    else if (arg == "--seed" && value) args.renderer.seed = std::atoi(argv[++i]);
+    else if (arg == "--no_color_lut") args.options.color_lut = false;
+    else if (arg == "--no_single_pass") args.options.single_pass = false;
+    else if (arg == "--no_roi_tracking") args.options.roi_tracking = false;
+    else if (arg == "--contours") args.options.blob_extractor = false;
+    else if (arg == "--no_native_ingest") args.options.native_ingest = false;
+    else if (arg == "--frame_budget" && value) args.options.frame_budget = std::atof(argv[++i]);
+    else if (arg[0] != '-' && args.input.empty()) args.input = arg;
+    else
+    {
+      std::fprintf(stderr, "Unknown or incomplete argument %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if ((args.input.empty() && !args.synthetic) || (args.params.empty() && !args.targets))
+  {
+    std::fprintf(stderr, "Usage: %s <images folder | file.bag> --params params.yaml [options]\n"
+                         "       %s --synthetic <frames> (--params params.yaml | --targets <n>) [options]\n",
+                 argv[0], argv[0]);
+    return false;
+  }
+  args.repeat = std::max(args.repeat, 1);
+  return true;
+}
+
+// colors of the other drones, same parameters as /uavs_info
+std::map<int, std::vector<int>> loadColors(const std::string& file, int uav_id)
+{
+  std::map<int, std::vector<int>> colors;
+  YAML::Node info = YAML::LoadFile(file)["uavs_info"];
+  int num_uavs = info["num_uavs"].as<int>();
+  for(int i = 0; i < num_uavs; i++)
+  {
+    YAML::Node uav = info["uav_" + std::to_string(i + 1)];
+    int id = uav["id"].as<int>();
+    if (id != uav_id)
+      colors[id] = {uav["r"].as<int>(), uav["g"].as<int>(), uav["b"].as<int>()};
+  }
+  return colors;
+}
+
+// evenly spaced saturated hues, ids from 1 without our own
+std::map<int, std::vector<int>> makeColors(int targets, int uav_id)
+{
+  std::map<int, std::vector<int>> colors;
+  for(int k = 0, id = 1; k < targets; k++, id++)
+  {
+    if (id == uav_id)
+      id++;
+    cv::Mat hsv(1, 1, CV_8UC3, cv::Scalar(180 * k / targets, 255, 255)), bgr;
+    cv::cvtColor(hsv, bgr, cv::COLOR_HSV2BGR);
+    cv::Vec3b c = bgr.at<cv::Vec3b>(0, 0);
+    colors[id] = {c[2], c[1], c[0]};
+  }
+  return colors;
+}
+
+// camera_calibration format, or the simulated camera (90 deg horizontal FOV)
+sensor_msgs::CameraInfo loadCameraInfo(const std::string& file, int width, int height)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  info.K = {width / 2.0, 0, width / 2.0, 0, width / 2.0, height / 2.0, 0, 0, 1};
+  if (file.empty())
+    return info;
+
+  YAML::Node calibration = YAML::LoadFile(file);
+  info.width = calibration["image_width"].as<int>();
+  info.height = calibration["image_height"].as<int>();
+  std::vector<double> K = calibration["camera_matrix"]["data"].as<std::vector<double>>();
+  std::copy(K.begin(), K.end(), info.K.begin());
+  return info;
+}
+
+bool loadBag(const BenchmarkArgs& args, std::vector<sensor_msgs::ImagePtr>& images,
+             sensor_msgs::CameraInfo& info, bool& info_found)
+{
+  rosbag::Bag bag(args.input, rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery({args.image_topic, args.camera_info_topic}));
+  for(const rosbag::MessageInstance& m : view)
+  {
+    if (sensor_msgs::ImagePtr image = m.instantiate<sensor_msgs::Image>())
+      images.push_back(image);
+    else if (sensor_msgs::CompressedImagePtr compressed = m.instantiate<sensor_msgs::CompressedImage>())
+      images.push_back(cv_bridge::toCvCopy(compressed, "bgr8")->toImageMsg());
+    else if (sensor_msgs::CameraInfoPtr camera = m.instantiate<sensor_msgs::CameraInfo>())
+    {
+      if (!info_found)
+        info = *camera;
+      info_found = true;
+    }
+  }
+  return !images.empty();
+}
+
+bool loadFolder(const BenchmarkArgs& args, std::vector<sensor_msgs::ImagePtr>& images)
+{
+  std::vector<cv::String> files;
+  cv::glob(args.input + "/*", files);
+  std::sort(files.begin(), files.end());
+
+  std_msgs::Header header;
+  for(const cv::String& file : files)
+  {
+    cv::Mat image = cv::imread(file, cv::IMREAD_COLOR);
+    if (!image.empty())
+      images.push_back(cv_bridge::CvImage(header, "bgr8", image).toImageMsg());
+  }
+  return !images.empty();
+}
+
+// drones of the synthetic camera, oscillating in the image and in depth
+struct SyntheticDrone
+{
+  double u, v, z, w, phase;
+};
+
+std::vector<SyntheticDrone> makeScene(const std::map<int, std::vector<int>>& colors, int width, int height,
+                                      unsigned int seed, std::vector<rosdrone_Detector::syntheticCamera::Target>& targets)
+{
+  cv::RNG rng(seed);
+  std::vector<SyntheticDrone> scene;
+  for(const auto& color : colors)
+  {
+    targets.push_back({color.first, Eigen::Vector3d::Zero(),
+                       cv::Scalar(color.second[2], color.second[1], color.second[0])});
+    scene.push_back({rng.uniform(0.2, 0.8) * width, rng.uniform(0.25, 0.75) * height,
+                     rng.uniform(2.0, 8.0), rng.uniform(0.3, 1.5), rng.uniform(0.0, 2 * CV_PI)});
+  }
+  return scene;
+}
+
+void moveScene(const std::vector<SyntheticDrone>& scene, const rosdrone_Detector::syntheticCamera& camera,
+               int width, int height, double t, std::vector<rosdrone_Detector::syntheticCamera::Target>& targets)
+{
+  for(unsigned int k = 0; k < scene.size(); k++)
+  {
+    const SyntheticDrone& d = scene[k];
+    double a = d.w * t + d.phase;
+    targets[k].position = camera.unproject(d.u + 0.15 * width * std::sin(a), d.v + 0.1 * height * std::cos(a),
+                                           d.z + std::sin(0.5 * a));
+  }
+}
+
+// bearings and distances of the detector against the rendered drones
+struct Accuracy
+{
+  int visible = 0, detected = 0, wrong = 0;
+  double angle = 0, max_angle = 0, distance = 0, max_distance = 0;
+
+  void add(const drones::FormationLink& output, const rosdrone_Detector::syntheticCamera& camera,
+           const std::vector<rosdrone_Detector::syntheticCamera::Target>& targets)
+  {
+    for(const auto& target : targets)
+      visible += camera.visible(target.position);
+
+    for(unsigned int i = 0; i < output.targets.size(); i++)
+    {
+      int id = std::atoi(output.targets[i].substr(5).c_str()); // "droneN"
+      auto target = std::find_if(targets.begin(), targets.end(), [id](const rosdrone_Detector::syntheticCamera::Target& t)
+                                 { return t.id == id; });
+      if (target == targets.end() || !camera.visible(target->position))
+      {
+        wrong++;
+        continue;
+      }
+
+      const geometry_msgs::Vector3& b = output.bearings[i];
+      double cosine = Eigen::Vector3d(b.x, b.y, b.z).dot(target->position.normalized());
+      double error = std::acos(std::min(1.0, cosine)) * 180 / CV_PI;
+      double range = std::abs(output.distances[i].data - target->position.norm()) / target->position.norm();
+      detected++;
+      angle += error;
+      max_angle = std::max(max_angle, error);
+      distance += range;
+      max_distance = std::max(max_distance, range);
+    }
+  }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  using rosdrone_Detector::stageProfiler;
+  using rosdrone_Detector::syntheticCamera;
+
+  BenchmarkArgs args;
+  if (!parseArgs(argc, argv, args))
+    return 1;
+
+  // ros::Time without a node: wall time
+  ros::Time::init();
+
+  std::map<int, std::vector<int>> colors = args.targets ? makeColors(args.targets, args.uav_id)
+                                                        : loadColors(args.params, args.uav_id);
+
+  // recorded images are decoded before measuring, synthetic frames are rendered between them
+  std::vector<sensor_msgs::ImagePtr> images;
+  sensor_msgs::CameraInfo info;
+  bool info_found = false, bag = args.input.size() > 4 && args.input.substr(args.input.size() - 4) == ".bag";
+  if (args.synthetic)
+  {
+    info = loadCameraInfo(args.camera, args.width, args.height);
+    args.width = info.width;
+    args.height = info.height;
+  }
+  else if (!(bag ? loadBag(args, images, info, info_found) : loadFolder(args, images)))
+  {
+    std::fprintf(stderr, "No images found in %s\n", args.input.c_str());
+    return 1;
+  }
+  else if (!info_found)
+    info = loadCameraInfo(args.camera, images[0]->width, images[0]->height);
+
+  rosdrone_Detector::ballDetector detector(args.uav_id, colors, args.options);
+  detector.camInfoCallback(info);
+
+  syntheticCamera camera(info, args.renderer);
+  std::vector<syntheticCamera::Target> targets;
+  std::vector<SyntheticDrone> scene = makeScene(colors, args.width, args.height, args.renderer.seed, targets);
+  cv::Mat rendered;
+  Accuracy accuracy;
+
+  // recorded stamps are kept, image folders and synthetic frames are played at --rate
+  const double period = 1.0 / args.rate;
+  const double first = images.empty() ? 0 : images.front()->header.stamp.toSec();
+  const double span = bag ? images.back()->header.stamp.toSec() - first + period : images.size() * period;
+  std::vector<double> stamps(images.size());
+  for(unsigned int i = 0; i < images.size(); i++)
+    stamps[i] = bag ? images[i]->header.stamp.toSec() - first : i * period;
+
+  const int frames = args.synthetic ? args.synthetic : args.repeat * images.size();
+  stageProfiler profiler;
+  profiler.reserve(frames);
+  std::vector<long> frameAllocations;
+  frameAllocations.reserve(frames);
+
+  for(int f = 0; f < frames; f++)
+  {
+    sensor_msgs::ImagePtr image;
+    if (args.synthetic)
+    {
+      moveScene(scene, camera, args.width, args.height, f * period, targets);
+      camera.render(targets, rendered);
+      image = cv_bridge::CvImage(std_msgs::Header(), "bgr8", rendered).toImageMsg();
+      image->header.stamp = ros::Time(1.0 + f * period);
+    }
+    else
+    {
+      const int i = f % images.size();
+      image = images[i];
+      image->header.stamp = ros::Time(1.0 + (f / images.size()) * span + stamps[i]);
+    }
+    image->header.seq = f + 1;
+
+    if (f == args.warmup)
+      detector.setProfiler(&profiler);
+
+    const long allocated = allocations;
+    {
+      stageProfiler::Scope frame(f < args.warmup ? nullptr : &profiler, stageProfiler::FRAME);
+      detector.imageCallback(image);
+    }
+    if (f >= args.warmup)
+    {
+      frameAllocations.push_back(allocations - allocated);
+      profiler.endFrame();
+      if (args.synthetic)
+        accuracy.add(detector.lastBearings(), camera, targets);
+    }
+  }
+
+  if (profiler.frames() == 0)
+  {
+    std::fprintf(stderr, "No frame measured: %d frames, %d of warmup\n", frames, args.warmup);
+    return 1;
+  }
+
+  std::printf("%-10s %10s %10s %10s %10s %10s\n", "stage", "mean[ms]", "p50[ms]", "p90[ms]", "p99[ms]", "max[ms]");
+  for(int s = 0; s < stageProfiler::STAGES; s++)
+  {
+    stageProfiler::Stage stage = static_cast<stageProfiler::Stage>(s);
+    std::printf("%-10s %10.3f %10.3f %10.3f %10.3f %10.3f\n", stageProfiler::name(s),
+                1e3 * profiler.mean(stage), 1e3 * profiler.percentile(stage, 0.5),
+                1e3 * profiler.percentile(stage, 0.9), 1e3 * profiler.percentile(stage, 0.99),
+                1e3 * profiler.percentile(stage, 1.0));
+  }
+
+  long total = 0, worst = 0;
+  for(long a : frameAllocations)
+  {
+    total += a;
+    worst = std::max(worst, a);
+  }
+  std::printf("\n%d frames (%dx%d), %.1f fps, %.1f allocations per frame (max %ld)\n",
+              profiler.frames(), info.width, info.height,
+              1.0 / profiler.mean(stageProfiler::FRAME),
+              double(total) / frameAllocations.size(), worst);
+  if (args.options.frame_budget > 0)
+    std::printf("frame budget %.1f ms, final degradation level %d\n",
+                1e3 * args.options.frame_budget, detector.degradationLevel());
+
+  if (args.synthetic)
+  {
+    const int detected = std::max(accuracy.detected, 1);
+    std::printf("%d/%d visible targets detected, %d wrong detections\n"
+                "bearing error %.3f deg (max %.3f), relative distance error %.2f %% (max %.2f %%)\n",
+                accuracy.detected, accuracy.visible, accuracy.wrong,
+                accuracy.angle / detected, accuracy.max_angle,
+                100 * accuracy.distance / detected, 100 * accuracy.max_distance);
+  }
+  return 0;
+}
@@ -8,14 +8,6 @@ int main(int argc, char** argv)
 
   rosdrone_Detector::ballDetector detector(nhg, nhp);
 
-  ros::Rate rate(15.0);
-
-  while (ros::ok())
-  {
-    ros::spinOnce();
-
-    detector.spinDetector();
-
-    rate.sleep();
-  }
+  // detection runs in the image callback, once per camera frame
+  ros::spin();
 }
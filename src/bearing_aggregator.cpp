@@ -0,0 +1,92 @@
+#include "bearing_aggregator.h"
+
+namespace rosdrone_Detector
+{
+
+// constructor
+bearingAggregator::bearingAggregator(const ros::NodeHandle& ng, const ros::NodeHandle& nl) : nhg(ng), nhl(nl)
+{
+  getParametersROS();
+  slots.resize(topics.size());
+  outputMessage.resize(topics.size());
+
+  // initialize communications
+  formationPub = nhg.advertise<drones::Formation>("bearings", 1);
+  for(unsigned int k = 0; k < topics.size(); k++)
+    linkSubs.push_back(nhg.subscribe<drones::FormationLink>(
+                         topics[k], 1, boost::bind(&bearingAggregator::linkCallback, this, _1, k)));
+  windowTimer = nhg.createTimer(ros::Duration(window), &bearingAggregator::windowCallback, this, true, false);
+
+  ROS_INFO("Bearing aggregator initialized with %d observers", (int)topics.size());
+}
+
+void bearingAggregator::getParametersROS()
+{
+  nhl.param("window", window, 0.05);
+
+  // bearing topics of the drones of /uavs_info unless given
+  if (nhl.getParam("topics", topics))
+    return;
+
+  int num_uavs = 0;
+  if (!nhg.getParam("/uavs_info/num_uavs", num_uavs))
+    ROS_ERROR("Some ROS parameters were not found! (~topics or /uavs_info/num_uavs)");
+
+  for (int i = 0; i < num_uavs; i++)
+  {
+    int id = i + 1;
+    nhg.getParam("/uavs_info/uav_" + std::to_string(i + 1) + "/id", id);
+    topics.push_back("/uav" + std::to_string(id) + "/bearing");
+  }
+}
+
+// callback functions
+
+void bearingAggregator::linkCallback(const drones::FormationLink::ConstPtr& link, int observer)
+{
+  Slot& slot = slots[observer];
+  slot.link = link;
+  if (!slot.fresh)
+  {
+    slot.fresh = true;
+    fresh++;
+  }
+
+  // a full set goes out at once, otherwise the first new link opens the window
+  if (fresh == (int)slots.size())
+    publishFormation();
+  else if (fresh == 1)
+  {
+    windowTimer.setPeriod(ros::Duration(window));
+    windowTimer.start();
+  }
+}
+
+void bearingAggregator::windowCallback(const ros::TimerEvent& event)
+{
+  if (fresh)
+    publishFormation();
+}
+
+void bearingAggregator::publishFormation()
+{
+  windowTimer.stop();
+
+  // assigned in place, the buffers of the links are reused by the next sets
+  int count = 0;
+  outputMessage.header().stamp = ros::Time::now();
+  for (Slot& slot : slots)
+  {
+    if (!slot.fresh)
+      continue;
+    outputMessage.drone(count) = slot.link->drone_name;
+    outputMessage.link(count) = *slot.link;
+    count++;
+    slot.fresh = false;
+  }
+  fresh = 0;
+
+  outputMessage.publish(formationPub, count);
+}
+
+}
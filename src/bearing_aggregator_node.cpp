@@ -0,0 +1,13 @@
+#include "bearing_aggregator.h"
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "bearing_aggregator_node");
+  ros::NodeHandle nhg, nhp("~");
+
+  rosdrone_Detector::bearingAggregator aggregator(nhg, nhp);
+
+  // published from the callbacks, when links arrive
+  ros::spin();
+}
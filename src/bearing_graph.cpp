@@ -0,0 +1,63 @@
+#include "bearing_graph.h"
+
+#include <algorithm>
+
+namespace rosdrone
+{
+
+void bearingGraph::build(int nodes, std::vector<std::pair<int, int>> edges)
+{
+  edges.erase(std::remove_if(edges.begin(), edges.end(),
+                             [nodes](const std::pair<int, int>& e)
+                             { return e.first < 0 || e.first >= nodes || e.second < 0 || e.second >= nodes || e.first == e.second; }),
+              edges.end());
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  int E = edges.size();
+
+  // outgoing rows, the edges are already sorted by observer
+  source.resize(E);
+  target.resize(E);
+  outOffset.assign(nodes + 1, 0);
+  for (int e = 0; e < E; e++)
+  {
+    source[e] = edges[e].first;
+    target[e] = edges[e].second;
+    outOffset[source[e] + 1]++;
+  }
+  for (int i = 0; i < nodes; i++)
+    outOffset[i + 1] += outOffset[i];
+
+  // incoming rows by counting sort on the target
+  inOffset.assign(nodes + 1, 0);
+  for (int e = 0; e < E; e++)
+    inOffset[target[e] + 1]++;
+  for (int i = 0; i < nodes; i++)
+    inOffset[i + 1] += inOffset[i];
+  inEdge.resize(E);
+  std::vector<int> next(inOffset.begin(), inOffset.end() - 1);
+  for (int e = 0; e < E; e++)
+    inEdge[next[target[e]]++] = e;
+
+  bearing.setZero(3, E);
+  desired.setZero(3, E);
+  desiredSpin.setZero(3, E);
+  distanceControl.assign(E, 0);
+  desiredDistance.setZero(E);
+  distance.setZero(E);
+  stamp.setZero(E);
+  measured.assign(E, 0);
+}
+
+void bearingGraph::buildComplete(int nodes)
+{
+  std::vector<std::pair<int, int>> edges;
+  edges.reserve(nodes * (nodes - 1));
+  for (int i = 0; i < nodes; i++)
+    for (int j = 0; j < nodes; j++)
+      if (i != j)
+        edges.emplace_back(i, j);
+  build(nodes, edges);
+}
+
+}
@@ -0,0 +1,57 @@
+#include "bearing_table.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+namespace rosdrone_Detector
+{
+
+bool bearingTable::matches(const sensor_msgs::CameraInfo& info, const Eigen::Matrix3d& _R, int _step) const
+{
+  return !empty() && _step == step && (int)info.width == width && (int)info.height == height &&
+         info.K == K && info.D == D && info.distortion_model == model && _R == R;
+}
+
+bool bearingTable::build(const sensor_msgs::CameraInfo& info, const Eigen::Matrix3d& _R, int _step)
+{
+  // the camera information is usually published with every image
+  if (matches(info, _R, _step))
+    return false;
+
+  step = _step;
+  width = info.width;
+  height = info.height;
+  K = info.K;
+  D = info.D;
+  model = info.distortion_model;
+  R = _R;
+  maxU = width - 1;
+  maxV = height - 1;
+
+  // nodes every step pixels, the last ones on or past the border, at least
+  // 2 x 2 so that ray() always has a cell to interpolate in
+  cols = std::max(2, (width - 1 + step - 1) / step + 1);
+  rows = std::max(2, (height - 1 + step - 1) / step + 1);
+  std::vector<cv::Point2f> pixels, normalized;
+  for(int j = 0; j < rows; j++)
+    for(int i = 0; i < cols; i++)
+      pixels.push_back(cv::Point2f(i * step, j * step));
+
+  cv::Mat cameraMatrix(3, 3, CV_64F, K.data());
+  if (D.empty() || std::all_of(D.begin(), D.end(), [](double d) { return d == 0; }))
+    cv::undistortPoints(pixels, normalized, cameraMatrix, cv::noArray());
+  else if (model == "equidistant")
+    cv::fisheye::undistortPoints(pixels, normalized, cameraMatrix, D);
+  else
+    cv::undistortPoints(pixels, normalized, cameraMatrix, D); // plumb_bob, rational_polynomial
+
+  rays.resize(normalized.size());
+  for(unsigned int n = 0; n < normalized.size(); n++)
+    rays[n] = (R * Eigen::Vector3d(normalized[n].x, normalized[n].y, 1)).cast<float>();
+
+  return true;
+}
+
+}
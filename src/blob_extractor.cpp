@@ -0,0 +1,26 @@
+#include "blob_extractor.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace rosdrone_Detector
+{
+
+const std::vector<Blob>& blobExtractor::extract(const cv::Mat& mask)
+{
+  // one labelling sweep gives area, bounding box and centroid of every blob
+  int n = cv::connectedComponentsWithStats(mask, labels_, stats_, centroids_, 8, CV_32S);
+
+  blobs_.resize(n > 0 ? n - 1 : 0);
+  for (int i = 1; i < n; i++)
+  {
+    Blob& blob = blobs_[i - 1];
+    blob.area = stats_.at<int>(i, cv::CC_STAT_AREA);
+    blob.box = cv::Rect(stats_.at<int>(i, cv::CC_STAT_LEFT), stats_.at<int>(i, cv::CC_STAT_TOP),
+                        stats_.at<int>(i, cv::CC_STAT_WIDTH), stats_.at<int>(i, cv::CC_STAT_HEIGHT));
+    blob.centroid = cv::Point2d(centroids_.at<double>(i, 0), centroids_.at<double>(i, 1));
+  }
+
+  return blobs_;
+}
+
+}
@@ -0,0 +1,215 @@
+#include "color_lut.h"
+#include "parallel_loop.h"
+
+#include <algorithm>
+#include <cstring>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace rosdrone_Detector
+{
+
+colorLUT::colorLUT() : table(bins * bins * bins, 0) {}
+
+void colorLUT::build(const std::vector<Target>& targets, int sat, int val, Space space)
+{
+  // center of every bin, laid out in table order, converted with OpenCV itself
+  cv::Mat centers(1, bins * bins * bins, CV_8UC3), hsv;
+  const int half = 1 << (7 - bits);
+  for (int b = 0; b < bins; b++)
+    for (int g = 0; g < bins; g++)
+      for (int r = 0; r < bins; r++)
+      {
+        cv::Vec3b& c = centers.at<cv::Vec3b>(0, (b << (2 * bits)) | (g << bits) | r);
+        c[0] = (b << (8 - bits)) + half;
+        c[1] = (g << (8 - bits)) + half;
+        c[2] = (r << (8 - bits)) + half;
+      }
+
+  if (space == YUV)
+  {
+    // pixel pairs sharing their chroma, decoded like a YUYV camera image
+    cv::Mat yuyv(1, 2 * centers.cols, CV_8UC2), bgr;
+    for (int i = 0; i < centers.cols; i++)
+    {
+      const cv::Vec3b& c = centers.at<cv::Vec3b>(0, i);
+      yuyv.at<cv::Vec2b>(0, 2 * i) = cv::Vec2b(c[0], c[1]);
+      yuyv.at<cv::Vec2b>(0, 2 * i + 1) = cv::Vec2b(c[0], c[2]);
+    }
+    cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+    for (int i = 0; i < centers.cols; i++)
+      centers.at<cv::Vec3b>(0, i) = bgr.at<cv::Vec3b>(0, 2 * i);
+  }
+  cv::cvtColor(centers, hsv, cv::COLOR_BGR2HSV);
+
+  for (int i = 0; i < hsv.cols; i++)
+  {
+    const cv::Vec3b& p = hsv.at<cv::Vec3b>(0, i);
+    table[i] = 0;
+    if (p[1] < sat || p[2] < val)
+      continue;
+
+    // when hue ranges overlap the closest target center wins
+    int best = 180;
+    for (unsigned int k = 0; k < targets.size(); k++)
+    {
+      const std::vector<int>& ranges = targets[k].ranges;
+      bool inside = false;
+      for (unsigned int j = 0; j + 1 < ranges.size(); j += 2)
+        inside = inside || (p[0] >= ranges[j] && p[0] <= ranges[j + 1]);
+      if (!inside)
+        continue;
+
+      int d = std::abs(p[0] - targets[k].hue);
+      d = std::min(d, 180 - d);
+      if (d < best)
+      {
+        best = d;
+        table[i] = k + 1;
+      }
+    }
+  }
+
+  sat_ = sat;
+  val_ = val;
+  space_ = space;
+  built = true;
+}
+
+void colorLUT::createMasks(cv::Size size, std::vector<cv::Mat>& masks)
+{
+  CV_Assert(masks.size() < 256);
+  for (auto& mask : masks)
+    mask.create(size, CV_8UC1);
+}
+
+void colorLUT::maskRow(const uchar* labels, std::vector<cv::Mat>& masks, int y, int n)
+{
+  // the label row is still in cache, each mask row is written once
+  const unsigned int count = masks.size();
+  uchar* rows[256];
+  for (unsigned int k = 0; k < count; k++)
+  {
+    rows[k] = masks[k].ptr<uchar>(y);
+    memset(rows[k], 0, n);
+  }
+  for (int x = 0; x < n; x++)
+  {
+    unsigned int label = labels[x];
+    if (label && label <= count)
+      rows[label - 1][x] = 255;
+  }
+}
+
+void colorLUT::classify(const cv::Mat& bgr, cv::Mat& labels, std::vector<cv::Mat>& masks) const
+{
+  CV_Assert(bgr.type() == CV_8UC3);
+  labels.create(bgr.size(), CV_8UC1);
+  createMasks(bgr.size(), masks);
+
+  // row stripes are independent
+  parallelFor(cv::Range(0, bgr.rows), [&](const cv::Range& rows)
+  {
+    for (int y = rows.start; y < rows.end; y++)
+    {
+      classifyRow(bgr.ptr<uchar>(y), labels.ptr<uchar>(y), bgr.cols);
+      maskRow(labels.ptr<uchar>(y), masks, y, bgr.cols);
+    }
+  });
+}
+
+void colorLUT::classifyRow(const uchar* bgr, uchar* labels, int n) const
+{
+  // unrolled so the compiler can interleave the independent table loads
+  int x = 0;
+  for (; x + 4 <= n; x += 4, bgr += 12)
+  {
+    labels[x]     = lookup(bgr[0], bgr[1], bgr[2]);
+    labels[x + 1] = lookup(bgr[3], bgr[4], bgr[5]);
+    labels[x + 2] = lookup(bgr[6], bgr[7], bgr[8]);
+    labels[x + 3] = lookup(bgr[9], bgr[10], bgr[11]);
+  }
+  for (; x < n; x++, bgr += 3)
+    labels[x] = lookup(bgr[0], bgr[1], bgr[2]);
+}
+
+void colorLUT::classifyYUV422(const cv::Mat& pairs, bool uyvy, cv::Mat& labels, std::vector<cv::Mat>& masks) const
+{
+  CV_Assert(pairs.type() == CV_8UC4);
+  labels.create(pairs.rows, 2 * pairs.cols, CV_8UC1);
+  createMasks(labels.size(), masks);
+  const int y0 = uyvy ? 1 : 0, u = uyvy ? 0 : 1, y1 = y0 + 2, v = u + 2;
+
+  parallelFor(cv::Range(0, pairs.rows), [&](const cv::Range& rows)
+  {
+    for (int y = rows.start; y < rows.end; y++)
+    {
+      const uchar* p = pairs.ptr<uchar>(y);
+      uchar* l = labels.ptr<uchar>(y);
+      for (int x = 0; x < pairs.cols; x++, p += 4, l += 2)
+      {
+        l[0] = lookup(p[y0], p[u], p[v]);
+        l[1] = lookup(p[y1], p[u], p[v]);
+      }
+      maskRow(labels.ptr<uchar>(y), masks, y, labels.cols);
+    }
+  });
+}
+
+void colorLUT::classifyYUV420(const cv::Mat& luma, const cv::Mat& chroma, bool vu, cv::Mat& labels, std::vector<cv::Mat>& masks) const
+{
+  CV_Assert(luma.type() == CV_8UC1 && chroma.type() == CV_8UC2 &&
+            2 * chroma.rows >= luma.rows && 2 * chroma.cols >= luma.cols);
+  labels.create(luma.size(), CV_8UC1);
+  createMasks(luma.size(), masks);
+  const int u = vu ? 1 : 0, v = 1 - u;
+
+  parallelFor(cv::Range(0, luma.rows), [&](const cv::Range& rows)
+  {
+    for (int y = rows.start; y < rows.end; y++)
+    {
+      const uchar* Y = luma.ptr<uchar>(y);
+      const uchar* uv = chroma.ptr<uchar>(y / 2);
+      uchar* l = labels.ptr<uchar>(y);
+      int x = 0;
+      for (; x + 2 <= luma.cols; x += 2, uv += 2)
+      {
+        l[x] = lookup(Y[x], uv[u], uv[v]);
+        l[x + 1] = lookup(Y[x + 1], uv[u], uv[v]);
+      }
+      if (x < luma.cols)
+        l[x] = lookup(Y[x], uv[u], uv[v]);
+      maskRow(l, masks, y, luma.cols);
+    }
+  });
+}
+
+void colorLUT::classifyBayer(const cv::Mat& top, const cv::Mat& bottom, int red, cv::Mat& labels, std::vector<cv::Mat>& masks) const
+{
+  CV_Assert(top.type() == CV_8UC2 && bottom.size() == top.size() && bottom.type() == CV_8UC2);
+  labels.create(2 * top.rows, 2 * top.cols, CV_8UC1);
+  createMasks(labels.size(), masks);
+  const int blue = 3 - red;
+  const int g0 = (red == 0 || red == 3) ? 1 : 0, g1 = 3 - g0;
+
+  // one label per quad, green averaged
+  parallelFor(cv::Range(0, top.rows), [&](const cv::Range& rows)
+  {
+    for (int y = rows.start; y < rows.end; y++)
+    {
+      const uchar* t = top.ptr<uchar>(y);
+      const uchar* b = bottom.ptr<uchar>(y);
+      uchar* l0 = labels.ptr<uchar>(2 * y);
+      uchar* l1 = labels.ptr<uchar>(2 * y + 1);
+      for (int x = 0; x < top.cols; x++, t += 2, b += 2)
+      {
+        const uchar q[4] = {t[0], t[1], b[0], b[1]};
+        uchar label = lookup(q[blue], (q[g0] + q[g1] + 1) >> 1, q[red]);
+        l0[2 * x] = l0[2 * x + 1] = l1[2 * x] = l1[2 * x + 1] = label;
+      }
+      maskRow(l0, masks, 2 * y, labels.cols);
+      maskRow(l1, masks, 2 * y + 1, labels.cols);
+    }
+  });
+}
+
+}
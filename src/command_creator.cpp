@@ -1,12 +1,11 @@
 #include "command_creator.h"
 
 using namespace std;
-geometry_msgs::Twist sharedTwist;
 
 namespace rosdrone
 {
 // constructor
-commandCreator::commandCreator(const ros::NodeHandle& ng, const ros::NodeHandle& np) : nh(ng), nhp(np)
+commandCreator::commandCreator(const ros::NodeHandle& ng, const ros::NodeHandle& np, commandChannel<geometry_msgs::Twist>& commands) : nh(ng), nhp(np), commands(commands)
 {
   // initialize values
   getROSParameters();
@@ -19,10 +18,18 @@ commandCreator::commandCreator(const ros::NodeHandle& ng, const ros::NodeHandle&
   bearings_sub = nh.subscribe("/bearings", 2, &commandCreator::bearingMeasuresCallback, this);
   poseSub = nh.subscribe("/gazebo/model_states", 2, &commandCreator::posesCallback, this);
   formationControlSub = nh.subscribe("/formation_control", 2, &commandCreator::formationControlCallback, this);
+  if (centralized)
+    commandSub = nh.subscribe("formation_command", 2, &commandCreator::formationCommandCallback, this);
 
   if(drone_ID == 2) errorFPub = nh.advertise<std_msgs::Float32>("errorF", 2);
-  if(drone_ID == 1) errorDist = nh.advertise<std_msgs::Float32>("errorDist", 2);
-  if(drone_ID == 1) desiredDist = nh.advertise<std_msgs::Float32>("desiredDist", 2);
+  if(distEdge >= 0) errorDist = nh.advertise<std_msgs::Float32>("errorDist", 2);
+  if(distEdge >= 0) desiredDist = nh.advertise<std_msgs::Float32>("desiredDist", 2);
+  if(monitorRigidity)
+  {
+    sensed.buildComplete(registry.size());
+    eigenvaluePub = nh.advertise<std_msgs::Float64>("rigidity_eigenvalue", 2);
+    eigenvectorPub = nh.advertise<std_msgs::Float64MultiArray>("rigidity_eigenvector", 2);
+  }
 
   ROS_INFO("Command initialized");
 }
@@ -35,105 +42,115 @@ commandCreator::~commandCreator()
 
 void commandCreator::spinCommand()
 {
-  calculateVelocityCommand();
+  // commands of the centralized controller are applied as they arrive
+  if (!centralized)
+    calculateVelocityCommand();
   publishError();
+  if (monitorRigidity)
+    publishRigidity();
   return;
 }
 
 void commandCreator::updateTwist()
 {
-  sharedTwist.linear.x = velocityCommand.u.x();
-  sharedTwist.linear.y = velocityCommand.u.y();
-  sharedTwist.linear.z = velocityCommand.u.z();
-
-  sharedTwist.angular.x = 0;
-  sharedTwist.angular.y = 0;
-  sharedTwist.angular.z = velocityCommand.w;
+  geometry_msgs::Twist twist;
+  twist.linear.x = velocityCommand.u.x();
+  twist.linear.y = velocityCommand.u.y();
+  twist.linear.z = velocityCommand.u.z();
+
+  twist.angular.x = 0;
+  twist.angular.y = 0;
+  twist.angular.z = velocityCommand.w;
+  commands.write(twist, ros::Time::now().toSec());
 }
 
 void commandCreator::publishError()
 {
   std_msgs::Float32 sum;
   sum.data = 0;
-  for (auto& drone_measures : relativeBearing)
-  {
-    int i = drone_measures.first;
-    for(auto& measure : drone_measures.second)
-    {
-      int j = measure.first;
-      if(relativeBearingDesired[i].count(j))
-        sum.data += (measure.second.bearing - relativeBearingDesired[i][j]).norm();
-    }
-  }
+  for (int e = 0; e < graph.edges(); e++)
+    if (graph.measured[e])
+      sum.data += (graph.bearing.col(e) - graph.desired.col(e)).norm();
   if(drone_ID == 2) errorFPub.publish(sum);
 
+  if(distEdge < 0)
+    return;
+
   std_msgs::Float32 dist;
-  dist.data = relativeBearing[1][2].distance;
-  if(drone_ID == 1) errorDist.publish(dist);
+  dist.data = graph.distance(distEdge);
+  errorDist.publish(dist);
 
   std_msgs::Float32 desDist;
-  desDist.data = 2.0;
-  if(drone_ID == 1) desiredDist.publish(desDist);
+  desDist.data = graph.desiredDistance(distEdge);
+  desiredDist.publish(desDist);
 }
 
-void commandCreator::setRelativeBearingDesired()
+void commandCreator::publishRigidity()
 {
-  std::vector<Eigen::Vector3d> drones;
-  drones.emplace_back(-1, 0, -0.3);
-  drones.emplace_back(sqrt(2)/2, sqrt(2)/2, 0.3);
-  drones.emplace_back(sqrt(2)/2, -sqrt(2)/2, 0);
-
-  Eigen::Matrix3d Rtemp;
-  std::vector<Eigen::Matrix3d> R;
-  Rtemp = Eigen::AngleAxisd(0.0, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-  Rtemp = Eigen::AngleAxisd(M_PI*7/8, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-  Rtemp = Eigen::AngleAxisd(-M_PI/2, Eigen::Vector3d::UnitZ());
-  R.push_back(Rtemp);
-
-  std::vector<std::pair<int, int> > pairs = { {1, 2}, {1,3}, {2,1}, {3,2} };
+  psi.resize(posesGazebo.size());
+  for (int i = 0; i < posesGazebo.size(); i++)
+    psi(i) = posesGazebo[i].valid ? posesGazebo[i].psi : 0.0;
+  // a lost link leaves the graph once its last measure is too old
+  sensed.expire(ros::Time::now().toSec(), edgeTimeout);
+  rigidity.update(sensed, psi);
+
+  std_msgs::Float64 eigenvalue;
+  eigenvalue.data = rigidity.eigenvalue();
+  eigenvaluePub.publish(eigenvalue);
+
+  std_msgs::Float64MultiArray eigenvector;
+  const Eigen::VectorXd& vector = rigidity.eigenvector();
+  eigenvector.data.assign(vector.data(), vector.data() + vector.size());
+  eigenvectorPub.publish(eigenvector);
+}
 
-  for(auto pair : pairs)
-    relativeBearingDesired[pair.first][pair.second] =
-        (R[pair.first-1]*(drones[pair.second-1] - drones[pair.first-1])).normalized();
+void commandCreator::setRelativeBearingDesired()
+{
+  // compiled once, gains of the file replace the defaults and the private
+  // parameters override those of the file
+  formationSpec spec;
+  spec.loadROS(nh, nhp);
+  spec.compile(registry, graph);
+  controlParams.kc = spec.gains.kc;
+  controlParams.kp_dist = spec.gains.kp_dist;
+
+  // first distance controlled edge of this drone, reported by publishError
+  distEdge = -1;
+  for(int e = graph.outBegin(drone_index); e < graph.outEnd(drone_index) && distEdge < 0; e++)
+    if(graph.distanceControl[e])
+      distEdge = e;
 }
 
 void commandCreator::calculateVelocityCommand()
 {
   Eigen::Matrix3d Rij;
 
-  auto my_measures = relativeBearing[drone_ID];
-
-  int i = drone_ID;
+  int i = drone_index;
   Eigen::Vector3d u = Eigen::Vector3d::Zero();
   double w = 0;
 
-  for(auto measure : my_measures)
+  // (I - g g^T) g* is applied as g* - g (g . g*)
+  for(int e = graph.outBegin(i); e < graph.outEnd(i); e++)
   {
-    int j = measure.first;
-    if(relativeBearingDesired[i].count(j))
-    {
-      Eigen::Vector3d bearing_ij = measure.second.bearing;
-      u -= controlParams.kc * (I - bearing_ij*bearing_ij.transpose()) * relativeBearingDesired[i][j];
-      w += controlParams.kc * bearing_ij.transpose() * S * relativeBearingDesired[i][j];
-      if(i == 1 && j == 2) u += distanceController(measure.second.distance) * bearing_ij;
-      if(i == 2 && j == 1) u += distanceController(measure.second.distance) * bearing_ij;
-    }
+    if(!graph.measured[e])
+      continue;
+    auto bearing_ij = graph.bearing.col(e);
+    auto desired_ij = graph.desired.col(e);
+    u -= controlParams.kc * (desired_ij - bearing_ij * bearing_ij.dot(desired_ij));
+    w += controlParams.kc * bearing_ij.dot(graph.desiredSpin.col(e));
+    if(graph.distanceControl[e]) u += distanceController(graph.distance(e), graph.desiredDistance(e)) * bearing_ij;
   }
 
-  for (auto drone_measures : relativeBearing)
+  for(int k = graph.inBegin(i); k < graph.inEnd(i); k++)
   {
-    if(drone_measures.first != i && drone_measures.second.count(i))
-    {
-      int j = drone_measures.first;
-      if(relativeBearingDesired[j].count(i))
-      {
-        Eigen::Vector3d bearing_ji = drone_measures.second[i].bearing;
-        Rij = Eigen::AngleAxisd(posesGazebo[j].psi - posesGazebo[i].psi, Eigen::Vector3d::UnitZ());
-        u += controlParams.kc * Rij * (I - bearing_ji*bearing_ji.transpose()) * relativeBearingDesired[j][i];
-      }
-    }
+    int e = graph.inEdge[k];
+    if(!graph.measured[e])
+      continue;
+    int j = graph.source[e];
+    auto bearing_ji = graph.bearing.col(e);
+    auto desired_ji = graph.desired.col(e);
+    Rij = Eigen::AngleAxisd(posesGazebo[j].psi - posesGazebo[i].psi, Eigen::Vector3d::UnitZ());
+    u += controlParams.kc * Rij * (desired_ji - bearing_ji * bearing_ji.dot(desired_ji));
   }
 
   nullSpaceMotions(u, w);
@@ -149,25 +166,30 @@ void commandCreator::nullSpaceMotions(Eigen::Vector3d& u, double& w)
     ROS_INFO_ONCE("Null-space motions initialized");
     Eigen::Vector3d centroid, translation_vel;
     double rotation, scale;
-    for (auto drone : posesGazebo)
+    int seen = 0;
+    centroid.setZero();
+    for (auto& drone : posesGazebo)
     {
-      centroid += drone.second.p;
+      if (!drone.valid)
+        continue;
+      centroid += drone.p;
+      seen++;
     }
-    centroid /= posesGazebo.size();
+    centroid /= std::max(seen, 1) * 1.0;
 
     translation_vel = 0.3*(_position - centroid);
 
     rotation = _rotation;
     scale = _scale;
 
-    auto poseInfo = posesGazebo[drone_ID];
+    auto& poseInfo = posesGazebo[drone_index];
 
     u += poseInfo.R.transpose() * (translation_vel + scale*(poseInfo.p - centroid) + rotation*S*(poseInfo.p - centroid));
     w += rotation;
   }
 }
 
-double commandCreator::distanceController(double distance)
+double commandCreator::distanceController(double distance, double desired)
 {
   if (distController.last_time_measure == 0)
   {
@@ -179,7 +201,7 @@ double commandCreator::distanceController(double distance)
   double dT = time - distController.last_time_measure;
   distController.last_time_measure = time;
 
-  double e = distController.distDesired - distance;
+  double e = desired - distance;
 
   return - controlParams.kp_dist * e;
 }
@@ -190,6 +212,20 @@ void commandCreator::getROSParameters()
   {
       ROS_ERROR("ROS parameter uav_id was not found!");
   }
+  nhp.param("centralized", centralized, false);
+  nhp.param("rigidity_monitor", monitorRigidity, false);
+  nhp.param("edge_timeout", edgeTimeout, edgeTimeout);
+
+  // per drone state is indexed by the registry
+  registry.load(nh);
+  drone_index = registry.indexOfId(drone_ID);
+  if (drone_index < 0)
+  {
+    ROS_ERROR("uav_id %d is not in /uavs_info", drone_ID);
+    drone_index = registry.add(drone_ID, "drone" + std::to_string(drone_ID), "drone" + std::to_string(drone_ID),
+                               "iris_" + std::to_string(drone_ID));
+  }
+  posesGazebo.resize(registry.size());
 }
 
 double commandCreator::getYawFromQuaternion(const geometry_msgs::Quaternion& q)
@@ -201,22 +237,24 @@ double commandCreator::getYawFromQuaternion(const geometry_msgs::Quaternion& q)
 
 void commandCreator::bearingMeasuresCallback(const drones::Formation& measures)
 {
+  double stamp = measures.header.stamp.isZero() ? ros::Time::now().toSec() : measures.header.stamp.toSec();
   for (int i=0; i<measures.links.size(); i++)
   {
-    string drone_name = measures.links[i].drone_name;
-    // int drone_id = drone_name[drone_name.length()-1] - 48 - 3; // experimental
-    int drone_id = drone_name[drone_name.length()-1] - 48; // simulation
+    int drone_id = registry.index(measures.links[i].drone_name);
+    if (drone_id < 0)
+      continue;
     for (int j=0; j<measures.links[i].targets.size(); j++)
     {
-      string target_name = measures.links[i].targets[j];
-      // int target_id = target_name[target_name.length()-1] - 48 - 3; // experimental
-      int target_id = target_name[target_name.length()-1] - 48; // simulation
+      int target_id = registry.index(measures.links[i].targets[j]);
+      if (target_id < 0)
+        continue;
 
       Eigen::Vector3d bearing;
       tf::vectorMsgToEigen(measures.links[i].bearings[j], bearing);
 
-      relativeBearing[drone_id][target_id].bearing = bearing;
-      relativeBearing[drone_id][target_id].distance = measures.links[i].distances[j].data;
+      graph.measure(drone_id, target_id, bearing, measures.links[i].distances[j].data, stamp);
+      if (monitorRigidity)
+        sensed.measure(drone_id, target_id, bearing, measures.links[i].distances[j].data, stamp);
     }
   }
 }
@@ -225,10 +263,10 @@ void commandCreator::posesCallback(const gazebo_msgs::ModelStates& poses)
 {
   for (int i = 0; i < poses.name.size(); i++)
   {
-    if (poses.name[i].find("iris_") != std::string::npos)
+    int id = registry.index(poses.name[i]);
+    if (id >= 0)
     {
-      int id = poses.name[i].at(poses.name[i].length() - 1) - 48;
-
+      posesGazebo[id].valid = true;
       tf::pointMsgToEigen(poses.pose[i].position, posesGazebo[id].p);
       tf::quaternionMsgToEigen(poses.pose[i].orientation, posesGazebo[id].q);
       posesGazebo[id].q.normalize();
@@ -238,6 +276,13 @@ void commandCreator::posesCallback(const gazebo_msgs::ModelStates& poses)
   }
 }
 
+void commandCreator::formationCommandCallback(const geometry_msgs::Twist& command)
+{
+  velocityCommand.u << command.linear.x, command.linear.y, command.linear.z;
+  velocityCommand.w = command.angular.z;
+  updateTwist();
+}
+
 void commandCreator::formationControlCallback(const drones::FormationControl& control)
 {
   formation_control_active = true;
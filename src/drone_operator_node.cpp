@@ -1,6 +1,10 @@
 #include "outerloop_controller.h"
 #include "command_creator.h"
+#include "command_channel.h"
+#include "realtime_loop.h"
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <thread>
 
 int main(int argc, char** argv)
 {
@@ -8,28 +12,107 @@ int main(int argc, char** argv)
   ros::NodeHandle nhg, nhp("~");
   ROS_INFO("Main Hover Node Launched");
 
-  rosdrone::outerLoopRT controller(nhg);
-  rosdrone::commandCreator command(nhg, nhp);
+  bool realtime;
+  nhp.param("realtime", realtime, false);
 
-  ros::Rate rate(15.0);
-  ROS_INFO("Outer loop starting at 15 hz");
+  // with a command rate the commands are computed on their own thread and
+  // callback queue, otherwise in the control loop; the real-time loop only
+  // publishes setpoints, so there they always have their own thread
+  double commandRate;
+  nhp.param("command_rate", commandRate, 0.0);
+  if (realtime && commandRate <= 0)
+  {
+    ROS_INFO("Real-time loop: commands computed on their own thread at 30 hz");
+    commandRate = 30.0;
+  }
+  ros::CallbackQueue commandQueue;
+  ros::NodeHandle nhc(nhg), nhcp(nhp);
+  if (commandRate > 0)
+  {
+    nhc.setCallbackQueue(&commandQueue);
+    nhcp.setCallbackQueue(&commandQueue);
+  }
 
-  double time = ros::Time::now().toSec();
+  rosdrone::commandChannel<geometry_msgs::Twist> commands;
+  rosdrone::outerLoopRT controller(nhg, nhp, commands);
+  rosdrone::commandCreator command(nhc, nhcp, commands);
 
-  while(!controller.takeoff())
+  std::thread commandThread;
+  if (commandRate > 0)
   {
-    ros::spinOnce();
-    rate.sleep();
+    ROS_INFO("Commands computed at %.0f hz", commandRate);
+    commandThread = std::thread([&]()
+    {
+      ros::Rate rate(commandRate);
+      while (ros::ok())
+      {
+        commandQueue.callAvailable();
+        command.spinCommand();
+        rate.sleep();
+      }
+    });
   }
 
-  while (ros::ok())
+  if (realtime)
   {
-    ROS_INFO_THROTTLE(5,"Hover Node Running");
-    ros::spinOnce();
+    rosdrone::RealtimeOptions options;
+    nhp.param("loop_rate", options.rate, options.rate);
+    nhp.param("rt_priority", options.priority, options.priority);
+    nhp.param("rt_cpu", options.cpu, options.cpu);
+    nhp.param("lock_memory", options.lockMemory, options.lockMemory);
+    nhp.param("statistics_rate", options.statisticsRate, options.statisticsRate);
+    nhp.param("histogram_bin_width", options.binWidth, options.binWidth);
+    nhp.param("histogram_bins", options.bins, options.bins);
+    rosdrone::realtimeLoop loop(nhp, options);
 
-    command.spinCommand();
-    controller.spinControl();
+    // takeoff calls services and reads the mavros state: not real time
+    ros::Rate rate(15.0);
+    while(ros::ok() && !controller.takeoff())
+    {
+      ros::spinOnce();
+      rate.sleep();
+    }
 
-    rate.sleep();
+    // from here the callbacks have their own thread, created before the
+    // loop thread switches to SCHED_FIFO, and the loop only reads the
+    // latest pose and command through lock-free channels
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    loop.configure();
+    loop.start();
+    while (ros::ok())
+    {
+      controller.spinControl();
+
+      loop.publishStatistics();
+      loop.wait();
+    }
   }
+  else
+  {
+    ros::Rate rate(15.0);
+    ROS_INFO("Outer loop starting at 15 hz");
+
+    while(ros::ok() && !controller.takeoff())
+    {
+      ros::spinOnce();
+      rate.sleep();
+    }
+
+    while (ros::ok())
+    {
+      ROS_INFO_THROTTLE(5,"Hover Node Running");
+      ros::spinOnce();
+
+      if (commandRate <= 0)
+        command.spinCommand();
+      controller.spinControl();
+
+      rate.sleep();
+    }
+  }
+
+  if (commandThread.joinable())
+    commandThread.join();
 }
@@ -0,0 +1,63 @@
+#include "drone_registry.h"
+
+namespace rosdrone
+{
+
+bool droneRegistry::load(const ros::NodeHandle& nh)
+{
+  int num_uavs = 0;
+  if (!nh.getParam("/uavs_info/num_uavs", num_uavs))
+  {
+    ROS_ERROR("ROS parameter /uavs_info/num_uavs was not found!");
+    return false;
+  }
+
+  for (int i = 0; i < num_uavs; i++)
+  {
+    std::string prefix = "/uavs_info/uav_" + std::to_string(i + 1) + "/";
+    int id = i + 1;
+    nh.getParam(prefix + "id", id);
+
+    std::string name, subject, model;
+    nh.param<std::string>(prefix + "name", name, "drone" + std::to_string(id));
+    nh.param<std::string>(prefix + "subject", subject, name);
+    nh.param<std::string>(prefix + "model", model, "iris_" + std::to_string(id));
+    add(id, name, subject, model);
+  }
+  return true;
+}
+
+int droneRegistry::add(int id, const std::string& name, const std::string& subject, const std::string& model)
+{
+  int index = ids.size();
+  ids.push_back(id);
+  names.push_back(name);
+  subjects.push_back(subject);
+  models.push_back(model);
+
+  aliases[model] = index;
+  aliases[subject] = index;
+  aliases[name] = index;
+  return index;
+}
+
+int droneRegistry::index(const std::string& alias)
+{
+  auto it = aliases.find(alias);
+  if (it != aliases.end())
+    return it->second;
+
+  // other models of the world, remembered on first sight
+  aliases.emplace(alias, -1);
+  return -1;
+}
+
+int droneRegistry::indexOfId(int id) const
+{
+  for (unsigned int k = 0; k < ids.size(); k++)
+    if (ids[k] == id)
+      return k;
+  return -1;
+}
+
+}
@@ -0,0 +1,216 @@
+#include "formation_controller.h"
+
+namespace rosdrone
+{
+// constructor
+formationController::formationController(const ros::NodeHandle& ng, const ros::NodeHandle& np) : nh(ng), nhp(np)
+{
+  getROSParameters();
+
+  // drones and edges are known once, buffers are allocated here
+  int N = registry.size(), E = graph.edges();
+  positions.setZero(3, N);
+  rotations.assign(N, Eigen::Matrix3d::Identity());
+  psi.setZero(N);
+  posed.assign(N, 0);
+  mask.resize(E);
+  dot.resize(E);
+  spin.resize(E);
+  c.resize(E);
+  s.resize(E);
+  projected.resize(3, E);
+  u.setZero(3, N);
+  w.setZero(N);
+
+  for (int e = 0; e < E; e++)
+    if (graph.distanceControl[e])
+      distanceEdges.push_back(e);
+
+  // initialize communications
+  bearingsSub = nh.subscribe("/bearings", 2, &formationController::bearingMeasuresCallback, this);
+  poseSub = nh.subscribe("/gazebo/model_states", 2, &formationController::posesCallback, this);
+  formationControlSub = nh.subscribe("/formation_control", 2, &formationController::formationControlCallback, this);
+  for (int i = 0; i < N; i++)
+    commandPubs.push_back(nh.advertise<geometry_msgs::Twist>(
+                            "/uav" + std::to_string(registry.id(i)) + "/formation_command", 2));
+
+  if (monitorRigidity)
+  {
+    sensed.buildComplete(N);
+    eigenvaluePub = nh.advertise<std_msgs::Float64>("rigidity_eigenvalue", 2);
+    eigenvectorPub = nh.advertise<std_msgs::Float64MultiArray>("rigidity_eigenvector", 2);
+  }
+
+  double rate;
+  nhp.param("rate", rate, 30.0);
+  timer = nh.createTimer(ros::Duration(1.0 / rate), &formationController::timerCallback, this);
+
+  ROS_INFO("Formation controller initialized with %d drones and %d edges at %.0f hz", N, E, rate);
+}
+
+void formationController::getROSParameters()
+{
+  nhp.param("rigidity_monitor", monitorRigidity, false);
+  nhp.param("edge_timeout", edgeTimeout, edgeTimeout);
+
+  registry.load(nh);
+
+  // compiled once, gains of the file replace the defaults and the private
+  // parameters override those of the file
+  formationSpec spec;
+  spec.loadROS(nh, nhp);
+  spec.compile(registry, graph);
+  controlParams = spec.gains;
+}
+
+void formationController::computeCommands()
+{
+  int E = graph.edges();
+  u.setZero();
+  w.setZero();
+
+  // per edge terms over contiguous columns:
+  // (I - g g^T) g* = g* - g (g . g*) and g^T S g* from the compiled table
+  auto g = graph.bearing.array();
+  auto gd = graph.desired.array();
+  for (int e = 0; e < E; e++)
+  {
+    mask(e) = graph.measured[e];
+    spin(e) = psi(graph.source[e]) - psi(graph.target[e]);
+  }
+  dot = (g * gd).colwise().sum().transpose();
+  projected = gd - g.rowwise() * dot.transpose();
+  projected.rowwise() *= (controlParams.kc * mask).transpose();
+  dot = controlParams.kc * mask * (g * graph.desiredSpin.array()).colwise().sum().transpose();
+  c = spin.cos();
+  s = spin.sin();
+
+  // scatter: the observer moves along its term, the target along the same
+  // term rotated by the yaw difference
+  for (int e = 0; e < E; e++)
+  {
+    int i = graph.source[e], j = graph.target[e];
+    u.col(i) -= projected.col(e).matrix();
+    w(i) += dot(e);
+    u(0, j) += c(e) * projected(0, e) - s(e) * projected(1, e);
+    u(1, j) += s(e) * projected(0, e) + c(e) * projected(1, e);
+    u(2, j) += projected(2, e);
+  }
+
+  for (int e : distanceEdges)
+    if (graph.measured[e])
+      u.col(graph.source[e]) -= controlParams.kp_dist * (graph.desiredDistance(e) - graph.distance(e)) * graph.bearing.col(e);
+
+  // null-space motions around the centroid of the known poses
+  if (formation_control_active)
+  {
+    int seen = 0;
+    Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+    for (int i = 0; i < registry.size(); i++)
+      if (posed[i])
+      {
+        centroid += positions.col(i);
+        seen++;
+      }
+    if (seen)
+    {
+      centroid /= (double)seen;
+      Eigen::Vector3d translation_vel = 0.3 * (_position - centroid);
+      Eigen::Matrix3d S;
+      S << 0, -1, 0, 1, 0, 0, 0, 0, 0;
+      for (int i = 0; i < registry.size(); i++)
+      {
+        if (!posed[i])
+          continue;
+        Eigen::Vector3d relative = positions.col(i) - centroid;
+        u.col(i) += rotations[i].transpose() * (translation_vel + _scale * relative + _rotation * S * relative);
+        w(i) += _rotation;
+      }
+    }
+  }
+}
+
+void formationController::publishCommands()
+{
+  for (int i = 0; i < registry.size(); i++)
+  {
+    commandMsg.linear.x = u(0, i);
+    commandMsg.linear.y = u(1, i);
+    commandMsg.linear.z = u(2, i);
+    commandMsg.angular.z = w(i);
+    commandPubs[i].publish(commandMsg);
+  }
+}
+
+// callback functions
+
+void formationController::timerCallback(const ros::TimerEvent& event)
+{
+  computeCommands();
+  publishCommands();
+  if (monitorRigidity)
+    publishRigidity();
+}
+
+void formationController::publishRigidity()
+{
+  // a lost link leaves the graph once its last measure is too old
+  sensed.expire(ros::Time::now().toSec(), edgeTimeout);
+  rigidity.update(sensed, psi);
+  eigenvalueMsg.data = rigidity.eigenvalue();
+  eigenvaluePub.publish(eigenvalueMsg);
+
+  const Eigen::VectorXd& vector = rigidity.eigenvector();
+  eigenvectorMsg.data.assign(vector.data(), vector.data() + vector.size());
+  eigenvectorPub.publish(eigenvectorMsg);
+}
+
+void formationController::bearingMeasuresCallback(const drones::Formation& measures)
+{
+  double stamp = measures.header.stamp.isZero() ? ros::Time::now().toSec() : measures.header.stamp.toSec();
+  Eigen::Vector3d bearing;
+  for (const drones::FormationLink& link : measures.links)
+  {
+    int drone = registry.index(link.drone_name);
+    if (drone < 0)
+      continue;
+    for (unsigned int j = 0; j < link.targets.size(); j++)
+    {
+      int target = registry.index(link.targets[j]);
+      if (target < 0)
+        continue;
+      tf::vectorMsgToEigen(link.bearings[j], bearing);
+      graph.measure(drone, target, bearing, link.distances[j].data, stamp);
+      if (monitorRigidity)
+        sensed.measure(drone, target, bearing, link.distances[j].data, stamp);
+    }
+  }
+}
+
+void formationController::posesCallback(const gazebo_msgs::ModelStates& poses)
+{
+  Eigen::Quaterniond q;
+  for (unsigned int k = 0; k < poses.name.size(); k++)
+  {
+    int i = registry.index(poses.name[k]);
+    if (i < 0)
+      continue;
+    Eigen::Vector3d p;
+    tf::pointMsgToEigen(poses.pose[k].position, p);
+    positions.col(i) = p;
+    tf::quaternionMsgToEigen(poses.pose[k].orientation, q);
+    rotations[i] = q.normalized().toRotationMatrix();
+    psi(i) = atan2(rotations[i](1, 0), rotations[i](0, 0));
+    posed[i] = 1;
+  }
+}
+
+void formationController::formationControlCallback(const drones::FormationControl& control)
+{
+  formation_control_active = true;
+  tf::vectorMsgToEigen(control.position, _position);
+  _rotation = control.rotation.data;
+  _scale = control.scale.data;
+}
+
+}
@@ -0,0 +1,13 @@
+#include "formation_controller.h"
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "formation_controller_node");
+  ros::NodeHandle nhg, nhp("~");
+
+  rosdrone::formationController controller(nhg, nhp);
+
+  // commands are computed and sent from the timer
+  ros::spin();
+}
@@ -0,0 +1,130 @@
+#include "formation_spec.h"
+
+#include <cmath>
+#include <yaml-cpp/yaml.h>
+
+namespace rosdrone
+{
+
+formationSpec::formationSpec()
+{
+  positions[1] = Eigen::Vector3d(-1, 0, -0.3);
+  positions[2] = Eigen::Vector3d(sqrt(2)/2, sqrt(2)/2, 0.3);
+  positions[3] = Eigen::Vector3d(sqrt(2)/2, -sqrt(2)/2, 0);
+  yaws[1] = 0.0;
+  yaws[2] = -M_PI*7/8;
+  yaws[3] = M_PI/2;
+  edges = { {1, 2}, {1,3}, {2,1}, {3,2} };
+  distanceEdges = { {1, 2}, {2, 1} };
+}
+
+bool formationSpec::load(const std::string& file)
+{
+  try
+  {
+    YAML::Node spec = YAML::LoadFile(file);
+
+    std::map<int, Eigen::Vector3d> file_positions;
+    std::map<int, double> file_yaws;
+    for (const YAML::Node& drone : spec["drones"])
+    {
+      int id = drone["id"].as<int>();
+      std::vector<double> p = drone["position"].as<std::vector<double>>();
+      if (p.size() != 3)
+        throw YAML::Exception(drone.Mark(), "position needs 3 coordinates");
+      file_positions[id] = Eigen::Vector3d(p[0], p[1], p[2]);
+      file_yaws[id] = drone["yaw"] ? drone["yaw"].as<double>() * M_PI / 180 : 0.0;
+    }
+
+    std::vector<std::pair<int, int>> file_edges, file_distance_edges;
+    for (const YAML::Node& edge : spec["edges"])
+      file_edges.emplace_back(edge[0].as<int>(), edge[1].as<int>());
+    for (const YAML::Node& edge : spec["distance_edges"])
+      file_distance_edges.emplace_back(edge[0].as<int>(), edge[1].as<int>());
+
+    FormationGains file_gains;
+    if (YAML::Node g = spec["gains"])
+    {
+      if (g["kc"]) file_gains.kc = g["kc"].as<double>();
+      if (g["kp_dist"]) file_gains.kp_dist = g["kp_dist"].as<double>();
+      if (g["scale"]) file_gains.scale = g["scale"].as<double>();
+    }
+
+    positions.swap(file_positions);
+    yaws.swap(file_yaws);
+    edges.swap(file_edges);
+    distanceEdges.swap(file_distance_edges);
+    gains = file_gains;
+  }
+  catch (const YAML::Exception& e)
+  {
+    ROS_ERROR("Formation file %s not loaded: %s", file.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+bool formationSpec::loadROS(const ros::NodeHandle& nh)
+{
+  std::string file;
+  if (!nh.getParam("/formation_file", file))
+  {
+    ROS_WARN("No /formation_file, using the three drones formation");
+    return false;
+  }
+  return load(file);
+}
+
+bool formationSpec::loadROS(const ros::NodeHandle& nh, const ros::NodeHandle& nhp)
+{
+  bool loaded = loadROS(nh);
+  nhp.param("kc", gains.kc, gains.kc);
+  nhp.param("kp_dist", gains.kp_dist, gains.kp_dist);
+  nhp.param("scale", gains.scale, gains.scale);
+  return loaded;
+}
+
+void formationSpec::compile(const droneRegistry& registry, bearingGraph& graph) const
+{
+  // edges of drones which are both in the formation and in the registry
+  std::vector<std::pair<int, int>> indices;
+  for (auto& edge : edges)
+  {
+    int i = registry.indexOfId(edge.first), j = registry.indexOfId(edge.second);
+    if (!positions.count(edge.first) || !positions.count(edge.second))
+      ROS_WARN("Formation edge %d -> %d dropped: uav not in the formation", edge.first, edge.second);
+    else if (i < 0 || j < 0)
+      ROS_WARN("Formation edge %d -> %d dropped: uav not in /uavs_info", edge.first, edge.second);
+    else if (i == j)
+      ROS_WARN("Formation edge %d -> %d dropped: a drone does not observe itself", edge.first, edge.second);
+    else
+      indices.emplace_back(i, j);
+  }
+  graph.build(registry.size(), indices);
+
+  for (int e = 0; e < graph.edges(); e++)
+  {
+    int i = registry.id(graph.source[e]), j = registry.id(graph.target[e]);
+    Eigen::Matrix3d R;
+    R = Eigen::AngleAxisd(yaws.at(i), Eigen::Vector3d::UnitZ());
+    Eigen::Vector3d desired = (R.transpose() * (positions.at(j) - positions.at(i))).normalized();
+
+    // g^T S g* = g . (S g*), S rotates by 90 degrees about z
+    graph.desired.col(e) = desired;
+    graph.desiredSpin.col(e) = Eigen::Vector3d(-desired.y(), desired.x(), 0);
+  }
+
+  for (auto& edge : distanceEdges)
+  {
+    int e = graph.find(registry.indexOfId(edge.first), registry.indexOfId(edge.second));
+    if (e >= 0)
+    {
+      graph.distanceControl[e] = 1;
+      graph.desiredDistance(e) = (positions.at(edge.second) - positions.at(edge.first)).norm() * gains.scale;
+    }
+    else
+      ROS_WARN("Distance edge %d -> %d dropped: not a formation edge", edge.first, edge.second);
+  }
+}
+
+}
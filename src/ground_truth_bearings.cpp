@@ -0,0 +1,317 @@
+#include "ground_truth_bearings.h"
+
+#include <algorithm>
+
+#include <eigen_conversions/eigen_msg.h>
+
+namespace rosdrone_Detector
+{
+
+// constructor
+groundTruthBearings::groundTruthBearings(const ros::NodeHandle& ng, const ros::NodeHandle& nl) : nhg(ng), nhl(nl)
+{
+  getParametersROS();
+
+  // pose and edge buffers are allocated once
+  int N = names.size(), E = edgeFrom.size();
+  positions.setZero(3, N);
+  rotations.setZero(9, N);
+  orientations.assign(N, Eigen::Quaterniond::Identity());
+  seen.assign(N, false);
+  fresh.assign(N, false);
+  delta.resize(E, 3);
+  bearings.resize(E, 3);
+  observerRotation.resize(E, 9);
+  distances.resize(E);
+
+  // one link per observer, the edges are sorted by observer
+  for (int e = 0; e < E; e++)
+  {
+    if (e == 0 || edgeFrom[e] != edgeFrom[e - 1])
+    {
+      outputMessage.drones.push_back(names[edgeFrom[e]]);
+      outputMessage.links.emplace_back();
+      outputMessage.links.back().drone_name = names[edgeFrom[e]];
+      linkEnd.push_back(e);
+    }
+    linkEnd.back() = e + 1;
+  }
+  for (unsigned int l = 0; l < outputMessage.links.size(); l++)
+  {
+    int size = linkEnd[l] - (l ? linkEnd[l - 1] : 0);
+    outputMessage.links[l].targets.reserve(size);
+    outputMessage.links[l].bearings.reserve(size);
+    outputMessage.links[l].distances.reserve(size);
+  }
+
+  // initialize communications
+  formationPub = nhg.advertise<drones::Formation>("bearings", 1);
+
+  std::string source;
+  nhl.param<std::string>("source", source, "qualisys");
+  if (source == "gazebo")
+    poseSubs.push_back(nhg.subscribe("/gazebo/model_states", 1, &groundTruthBearings::modelStatesCallback, this));
+  else
+  {
+    for (int k = 0; k < N; k++)
+      poseSubs.push_back(nhg.subscribe<qualisys::Subject>(
+                           "/qualisys/" + registry.subject(k), 1, boost::bind(&groundTruthBearings::subjectCallback, this, _1, k)));
+  }
+
+  // mocap poses forwarded as fake gazebo states and as one drone's mavros pose
+  bool fake_model_states;
+  nhl.param("fake_model_states", fake_model_states, false);
+  if (fake_model_states)
+  {
+    modelStatesPub = nhg.advertise<gazebo_msgs::ModelStates>("gazebo/model_states_fake", 1);
+    for (int k = 0; k < N; k++)
+      modelStatesMessage.name.push_back(registry.model(k));
+    modelStatesMessage.pose.resize(N);
+    modelStatesMessage.twist.resize(N);
+  }
+  std::string mocap_drone;
+  if (nhl.getParam("mocap_drone", mocap_drone))
+  {
+    mocapDrone = registry.index(mocap_drone);
+    if (mocapDrone >= 0)
+      mocapPosePub = nhg.advertise<geometry_msgs::PoseStamped>("mocap_pose", 1);
+  }
+
+  ROS_INFO("Ground truth bearings initialized with %d drones and %d edges from %s", N, E, source.c_str());
+}
+
+void groundTruthBearings::getParametersROS()
+{
+  // drones of /uavs_info unless given, with their mocap subjects and models
+  std::vector<std::string> drone_names, subjects, models;
+  if (nhl.getParam("drones", drone_names))
+  {
+    nhl.getParam("subjects", subjects);
+    nhl.getParam("models", models);
+    for (unsigned int i = 0; i < drone_names.size(); i++)
+      registry.add(i + 1, drone_names[i], i < subjects.size() ? subjects[i] : drone_names[i],
+                   i < models.size() ? models[i] : "iris_" + std::to_string(i + 1));
+  }
+  else
+    registry.load(nhg);
+  for (int i = 0; i < registry.size(); i++)
+    names.push_back(registry.name(i));
+
+  // [observer, target] pairs of uav ids, as in the formation file, every
+  // ordered pair unless given
+  std::vector<std::pair<int, int>> edges;
+  XmlRpc::XmlRpcValue list;
+  if (nhl.getParam("edges", list) && list.getType() == XmlRpc::XmlRpcValue::TypeArray)
+  {
+    for (int e = 0; e < list.size(); e++)
+    {
+      XmlRpc::XmlRpcValue& edge = list[e];
+      if (edge.getType() != XmlRpc::XmlRpcValue::TypeArray || edge.size() != 2 ||
+          edge[0].getType() != XmlRpc::XmlRpcValue::TypeInt || edge[1].getType() != XmlRpc::XmlRpcValue::TypeInt)
+      {
+        ROS_ERROR("~edges entry %d ignored, edges are [observer, target] pairs of uav ids", e);
+        continue;
+      }
+      edges.push_back(std::make_pair(static_cast<int>(edge[0]), static_cast<int>(edge[1])));
+    }
+  }
+  else
+  {
+    for (int i = 0; i < registry.size(); i++)
+      for (int j = 0; j < registry.size(); j++)
+        if (i != j)
+          edges.push_back(std::make_pair(registry.id(i), registry.id(j)));
+  }
+
+  std::vector<std::pair<int, int>> pairs;
+  for (auto& edge : edges)
+  {
+    int i = registry.indexOfId(edge.first), j = registry.indexOfId(edge.second);
+    if (i < 0 || j < 0 || i == j)
+    {
+      ROS_ERROR("Edge %d -> %d ignored, not a pair of known uav ids", edge.first, edge.second);
+      continue;
+    }
+    pairs.push_back(std::make_pair(i, j));
+  }
+  std::stable_sort(pairs.begin(), pairs.end(),
+                   [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+  for (auto& p : pairs)
+  {
+    edgeFrom.push_back(p.first);
+    edgeTo.push_back(p.second);
+  }
+
+  // sensing graph of the cameras, otherwise every edge is measured
+  nhl.param("visibility", useVisibility, false);
+  if (useVisibility)
+  {
+    VisibilityOptions options;
+    double fov_horizontal, fov_vertical;
+    nhl.param("fov_horizontal", fov_horizontal, 90.0);
+    nhl.param("fov_vertical", fov_vertical, 70.0);
+    options.fovHorizontal = fov_horizontal * M_PI / 180;
+    options.fovVertical = fov_vertical * M_PI / 180;
+    nhl.param("range_min", options.rangeMin, options.rangeMin);
+    nhl.param("range_max", options.rangeMax, options.rangeMax);
+    nhl.param("occluder_radius", options.occluderRadius, options.occluderRadius);
+    visibility = visibilityGraph(options);
+  }
+
+  int seed;
+  nhl.param("bearing_noise", bearingNoise, 0.0);
+  nhl.param("distance_noise", distanceNoise, 0.0);
+  nhl.param("seed", seed, 0);
+  generator.seed(seed);
+}
+
+void groundTruthBearings::setPose(int drone, const Eigen::Vector3d& position, const Eigen::Quaterniond& orientation)
+{
+  positions.col(drone) = position;
+  Eigen::Map<Eigen::Matrix3d>(rotations.col(drone).data()) = orientation.toRotationMatrix();
+  orientations[drone] = orientation;
+
+  if (!seen[drone])
+  {
+    seen[drone] = true;
+    seenCount++;
+  }
+  if (!fresh[drone])
+  {
+    fresh[drone] = true;
+    freshCount++;
+  }
+}
+
+void groundTruthBearings::computeEdges()
+{
+  // gather: relative positions and observer rotations per edge
+  int E = edgeFrom.size();
+  for (int e = 0; e < E; e++)
+  {
+    delta.row(e) = (positions.col(edgeTo[e]) - positions.col(edgeFrom[e])).transpose();
+    observerRotation.row(e) = rotations.col(edgeFrom[e]).transpose();
+  }
+
+  // contiguous columns over all edges, b_i = R.col(i) . d
+  distances = delta.rowwise().norm();
+  for (int i = 0; i < 3; i++)
+    bearings.col(i) = observerRotation.col(3 * i).cwiseProduct(delta.col(0))
+                      + observerRotation.col(3 * i + 1).cwiseProduct(delta.col(1))
+                      + observerRotation.col(3 * i + 2).cwiseProduct(delta.col(2));
+  bearings.array().colwise() /= distances.array().max(1e-9);
+}
+
+void groundTruthBearings::addNoise()
+{
+  int E = edgeFrom.size();
+  if (bearingNoise > 0)
+  {
+    for (int e = 0; e < E; e++)
+      for (int i = 0; i < 3; i++)
+        bearings(e, i) += bearingNoise * normal(generator);
+    bearings.array().colwise() /= bearings.rowwise().norm().array().max(1e-9);
+  }
+  if (distanceNoise > 0)
+    for (int e = 0; e < E; e++)
+      distances(e) = std::max(0.0, distances(e) + distanceNoise * normal(generator));
+}
+
+// callback functions
+
+void groundTruthBearings::subjectCallback(const qualisys::Subject::ConstPtr& subject, int drone)
+{
+  // a subject seen twice starts a new frame, some subjects were occluded
+  if (fresh[drone])
+    publishFormation(frameStamp);
+  frameStamp = subject->header.stamp;
+
+  Eigen::Vector3d position;
+  Eigen::Quaterniond orientation;
+  tf::pointMsgToEigen(subject->position, position);
+  tf::quaternionMsgToEigen(subject->orientation, orientation);
+  setPose(drone, position, orientation.normalized());
+
+  if (drone == mocapDrone)
+  {
+    mocapPoseMessage.header.stamp = ros::Time::now();
+    mocapPoseMessage.pose.position = subject->position;
+    mocapPoseMessage.pose.orientation = subject->orientation;
+    mocapPosePub.publish(mocapPoseMessage);
+  }
+
+  // one mocap frame holds every subject, published once all were updated
+  if (freshCount == (int)names.size())
+    publishFormation(subject->header.stamp);
+}
+
+void groundTruthBearings::modelStatesCallback(const gazebo_msgs::ModelStates::ConstPtr& states)
+{
+  Eigen::Vector3d position;
+  Eigen::Quaterniond orientation;
+  for (unsigned int i = 0; i < states->name.size(); i++)
+  {
+    int drone = registry.index(states->name[i]);
+    if (drone < 0)
+      continue;
+    tf::pointMsgToEigen(states->pose[i].position, position);
+    tf::quaternionMsgToEigen(states->pose[i].orientation, orientation);
+    setPose(drone, position, orientation.normalized());
+  }
+
+  if (seenCount == (int)names.size())
+    publishFormation(ros::Time::now());
+}
+
+void groundTruthBearings::publishFormation(const ros::Time& stamp)
+{
+  std::fill(fresh.begin(), fresh.end(), false);
+  freshCount = 0;
+  if (seenCount < (int)names.size())
+    return;
+
+  computeEdges();
+  addNoise();
+  if (useVisibility)
+    visibility.update(positions, rotations);
+
+  // links are laid out in edge order, their buffers are reserved
+  int e = 0;
+  for (unsigned int l = 0; l < outputMessage.links.size(); l++)
+  {
+    drones::FormationLink& link = outputMessage.links[l];
+    link.targets.clear();
+    link.bearings.clear();
+    link.distances.clear();
+    for (; e < linkEnd[l]; e++)
+    {
+      if (useVisibility && !visibility.visible(edgeFrom[e], edgeTo[e]))
+        continue;
+      link.targets.push_back(names[edgeTo[e]]);
+      link.distances.emplace_back();
+      link.distances.back().data = distances(e);
+      link.bearings.emplace_back();
+      link.bearings.back().x = bearings(e, 0);
+      link.bearings.back().y = bearings(e, 1);
+      link.bearings.back().z = bearings(e, 2);
+    }
+  }
+
+  outputMessage.header.stamp = stamp.isZero() ? ros::Time::now() : stamp;
+  formationPub.publish(outputMessage);
+
+  if (modelStatesPub)
+    publishModelStates();
+}
+
+void groundTruthBearings::publishModelStates()
+{
+  for (unsigned int k = 0; k < names.size(); k++)
+  {
+    tf::pointEigenToMsg(positions.col(k), modelStatesMessage.pose[k].position);
+    tf::quaternionEigenToMsg(orientations[k], modelStatesMessage.pose[k].orientation);
+  }
+  modelStatesPub.publish(modelStatesMessage);
+}
+
+}
@@ -0,0 +1,13 @@
+#include "ground_truth_bearings.h"
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "ground_truth_bearings_node");
+  ros::NodeHandle nhg, nhp("~");
+
+  rosdrone_Detector::groundTruthBearings synthesizer(nhg, nhp);
+
+  // published from the callbacks, at the rate of the poses
+  ros::spin();
+}
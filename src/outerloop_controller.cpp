@@ -1,11 +1,12 @@
 #include "outerloop_controller.h"
-#include "command_creator.h"
 
 namespace rosdrone
 {
   // constructor
-  outerLoopRT::outerLoopRT(const ros::NodeHandle& n) : nh(n)
+  outerLoopRT::outerLoopRT(const ros::NodeHandle& n, const ros::NodeHandle& np, commandChannel<geometry_msgs::Twist>& commands) : nh(n), nhp(np), commands(commands)
   {
+    nhp.param("command_timeout", commandTimeout, commandTimeout);
+
     // initialize communications
     controlPub = nh.advertise<geometry_msgs::Twist>("mavros/setpoint_velocity/cmd_vel_unstamped",2);
 
@@ -83,11 +84,25 @@ namespace rosdrone
     if(ros::Time::now().toSec() - last_service_call > 15.0)
     {
       ROS_INFO_ONCE("Bearing control enabled!");
-      vel_command = sharedTwist;
+      commands.read();
+      const commandChannel<geometry_msgs::Twist>::Sample& command = commands.latest();
+      bool stale = command.sequence == 0 || ros::Time::now().toSec() - command.stamp > commandTimeout;
+      if (stale && !commandStale)
+        ROS_WARN("Velocity command %lu is stale, hovering", (unsigned long)command.sequence);
+      commandStale = stale;
+
+      if (stale)
+      {
+        tf::vectorEigenToMsg(Eigen::Vector3d(0,0,0), vel_command.linear);
+        tf::vectorEigenToMsg(Eigen::Vector3d(0,0,0), vel_command.angular);
+      }
+      else
+        vel_command = command.value;
     }
     else
     {
-      double u = 1.5*(2.0 - pose.p[2]);
+      poses.read();
+      double u = 1.5*(2.0 - poses.latest().value.p[2]);
       tf::vectorEigenToMsg(Eigen::Vector3d(0,0,u), vel_command.linear);
       tf::vectorEigenToMsg(Eigen::Vector3d(0,0,0), vel_command.angular);
     }
@@ -100,17 +115,18 @@ namespace rosdrone
 
   void outerLoopRT::poseCallBack(const geometry_msgs::PoseStamped::ConstPtr& msg)
   {
-    poseMsgIn = *msg;
-
-    pose.p << poseMsgIn.pose.position.x,
-              poseMsgIn.pose.position.y,
-              poseMsgIn.pose.position.z;
-    pose.q.x()=poseMsgIn.pose.orientation.x;
-    pose.q.y()=poseMsgIn.pose.orientation.y;
-    pose.q.z()=poseMsgIn.pose.orientation.z;
-    pose.q.w()=poseMsgIn.pose.orientation.w;
+    PoseStructure pose;
+    pose.initialized = true;
+    pose.p << msg->pose.position.x,
+              msg->pose.position.y,
+              msg->pose.position.z;
+    pose.q.x()=msg->pose.orientation.x;
+    pose.q.y()=msg->pose.orientation.y;
+    pose.q.z()=msg->pose.orientation.z;
+    pose.q.w()=msg->pose.orientation.w;
     pose.q.normalize();
     pose.R = pose.q.toRotationMatrix();
+    poses.write(pose, msg->header.stamp.toSec());
     return;
   }
 
@@ -0,0 +1,154 @@
+#include "realtime_loop.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+namespace rosdrone
+{
+
+realtimeLoop::realtimeLoop(const ros::NodeHandle& np, const RealtimeOptions& _options) : options(_options), nhp(np)
+{
+  // invalid options fall back to the defaults
+  const RealtimeOptions defaults;
+  if (!(options.rate > 0 && options.rate <= 1e6))
+  {
+    ROS_ERROR("Real-time loop rate must be in (0, 1e6] hz, using %.0f hz", defaults.rate);
+    options.rate = defaults.rate;
+  }
+  if (!(options.statisticsRate > 0))
+  {
+    ROS_ERROR("Loop statistics rate must be positive, using %.0f hz", defaults.statisticsRate);
+    options.statisticsRate = defaults.statisticsRate;
+  }
+  if (!(options.binWidth > 0))
+  {
+    ROS_ERROR("Histogram bin width must be positive, using %g s", defaults.binWidth);
+    options.binWidth = defaults.binWidth;
+  }
+  if (options.bins < 1)
+  {
+    ROS_ERROR("Histograms need at least one bin, using %d", defaults.bins);
+    options.bins = defaults.bins;
+  }
+
+  period = 1e9 / options.rate;
+  jitterHistogram.assign(options.bins, 0);
+  computeHistogram.assign(options.bins, 0);
+  statistics.jitter_histogram.resize(options.bins);
+  statistics.compute_histogram.resize(options.bins);
+  statisticsPub = nhp.advertise<drones::LoopStatistics>("loop_statistics", 2);
+}
+
+void realtimeLoop::configure()
+{
+  if (options.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    ROS_WARN("mlockall failed: %s", strerror(errno));
+
+  if (options.cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options.cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error)
+      ROS_WARN("Pinning the loop to cpu %d failed: %s", options.cpu, strerror(error));
+  }
+
+  if (options.priority > 0)
+  {
+    sched_param param;
+    param.sched_priority = options.priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error)
+      ROS_WARN("SCHED_FIFO priority %d refused: %s", options.priority, strerror(error));
+  }
+
+  ROS_INFO("Real-time loop at %.0f hz, priority %d, cpu %d", options.rate, options.priority, options.cpu);
+}
+
+void realtimeLoop::start()
+{
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  wakeup = deadline;
+  advance(deadline, period);
+  computing = false;
+}
+
+void realtimeLoop::advance(timespec& t, long nanoseconds)
+{
+  t.tv_nsec += nanoseconds;
+  while (t.tv_nsec >= 1000000000L)
+  {
+    t.tv_nsec -= 1000000000L;
+    t.tv_sec++;
+  }
+}
+
+void realtimeLoop::record(std::vector<uint32_t>& histogram, double t)
+{
+  int bin = t / options.binWidth;
+  histogram[std::max(0, std::min(bin, options.bins - 1))]++;
+}
+
+void realtimeLoop::wait()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (computing)
+  {
+    double compute = seconds(now) - seconds(wakeup);
+    record(computeHistogram, compute);
+    computeSum += compute;
+    computeMax = std::max(computeMax, compute);
+  }
+
+  // overran: skip to the first deadline still ahead
+  double late = seconds(now) - seconds(deadline);
+  if (late > 0)
+  {
+    long skipped = late * 1e9 / period + 1;
+    missed += skipped;
+    advance(deadline, skipped * period);
+  }
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+  clock_gettime(CLOCK_MONOTONIC, &wakeup);
+  double jitter = seconds(wakeup) - seconds(deadline);
+  record(jitterHistogram, jitter);
+  jitterSum += jitter;
+  jitterMax = std::max(jitterMax, jitter);
+  samples++;
+  iterations++;
+  computing = true;
+  advance(deadline, period);
+}
+
+void realtimeLoop::publishStatistics()
+{
+  if (seconds(wakeup) - lastPublished < 1.0 / options.statisticsRate)
+    return;
+  lastPublished = seconds(wakeup);
+
+  statistics.header.stamp = ros::Time::now();
+  statistics.rate = options.rate;
+  statistics.iterations = iterations;
+  statistics.missed_deadlines = missed;
+  statistics.jitter_mean = samples ? jitterSum / samples : 0;
+  statistics.jitter_max = jitterMax;
+  statistics.compute_mean = samples ? computeSum / samples : 0;
+  statistics.compute_max = computeMax;
+  statistics.bin_width = options.binWidth;
+  std::copy(jitterHistogram.begin(), jitterHistogram.end(), statistics.jitter_histogram.begin());
+  std::copy(computeHistogram.begin(), computeHistogram.end(), statistics.compute_histogram.begin());
+  statisticsPub.publish(statistics);
+
+  samples = 0;
+  jitterSum = jitterMax = computeSum = computeMax = 0;
+}
+
+}
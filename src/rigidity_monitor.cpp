@@ -0,0 +1,119 @@
+#include "rigidity_monitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rosdrone
+{
+
+void rigidityMonitor::buildMatrix(const bearingGraph& graph, const Eigen::VectorXd& psi)
+{
+  // rows of edge i -> j with bearing b and distance d, drones in body frames:
+  //   d b / d v_i = -P / d,  d b / d v_j = P R_ij / d,  d b / d psi_i = -S b
+  // where P = I - b b^T and R_ij rotates the frame of j into the frame of i
+  int N = graph.nodes(), E = graph.edges();
+  triplets.clear();
+  triplets.reserve(30 * E);
+  int rows = 0;
+  for (int e = 0; e < E; e++)
+  {
+    if (!graph.measured[e])
+      continue;
+    int i = graph.source[e], j = graph.target[e];
+    Eigen::Vector3d b = graph.bearing.col(e).normalized();
+    double d = graph.distance(e) > 1e-6 ? graph.distance(e) : 1.0;
+    Eigen::Matrix3d P = (Eigen::Matrix3d::Identity() - b * b.transpose()) / d;
+    Eigen::Matrix3d Rij;
+    Rij = Eigen::AngleAxisd(psi(j) - psi(i), Eigen::Vector3d::UnitZ());
+    Eigen::Matrix3d PR = P * Rij;
+    Eigen::Vector3d Sb(-b.y(), b.x(), 0);
+
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        triplets.emplace_back(rows + r, 4 * i + c, -P(r, c));
+        triplets.emplace_back(rows + r, 4 * j + c, PR(r, c));
+      }
+      triplets.emplace_back(rows + r, 4 * i + 3, -Sb(r));
+    }
+    rows += 3;
+  }
+  B.resize(rows, 4 * N);
+  B.setFromTriplets(triplets.begin(), triplets.end());
+}
+
+void rigidityMonitor::apply(const Eigen::MatrixXd& x, Eigen::MatrixXd& y)
+{
+  y.noalias() = M * x;
+}
+
+void rigidityMonitor::update(const bearingGraph& graph, const Eigen::VectorXd& psi)
+{
+  buildMatrix(graph, psi);
+  int n = B.cols(), k = std::min(TRIVIAL + 1, n);
+  if (k <= TRIVIAL)
+  {
+    lambda = 0;
+    vector.setZero(n);
+    return;
+  }
+
+  // warm start from the previous eigenvectors when the size is unchanged
+  if (X.rows() != n || X.cols() != k)
+  {
+    X = Eigen::MatrixXd::Random(n, k);
+    P.resize(n, 0);
+  }
+  X = Eigen::HouseholderQR<Eigen::MatrixXd>(X).householderQ() * Eigen::MatrixXd::Identity(n, k);
+
+  // B^T B and its slightly shifted factorization as preconditioner, the
+  // shift keeps it defined on the kernel of the trivial motions
+  M = B.transpose() * B;
+  shifted = M;
+  double shift = 1e-3 * std::max(M.diagonal().mean(), 1e-12);
+  for (int c = 0; c < n; c++)
+    shifted.coeffRef(c, c) += shift;
+  preconditioner.compute(shifted);
+  apply(X, AX);
+
+  lastIterations = 0;
+  for (int it = 0; it < maxIterations; it++)
+  {
+    // Rayleigh quotients and residuals of the current block
+    Eigen::MatrixXd XAX = X.transpose() * AX;
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> ritz(XAX);
+    X = X * ritz.eigenvectors();
+    AX = AX * ritz.eigenvectors();
+    values = ritz.eigenvalues();
+    R = AX - X * values.asDiagonal();
+    lastIterations = it;
+    double scale = std::max(values.cwiseAbs().maxCoeff(), 1.0);
+    if (R.colwise().norm().maxCoeff() < tolerance * scale)
+      break;
+
+    // Rayleigh-Ritz over [X, T R, P], orthonormalized; dependent directions
+    // are dropped
+    W = preconditioner.solve(R);
+    int m = k + W.cols() + P.cols();
+    basis.resize(n, m);
+    basis << X, W, P;
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(basis);
+    qr.setThreshold(1e-10);
+    int rank = std::min<int>(qr.rank(), n);
+    Eigen::MatrixXd Q = qr.householderQ() * Eigen::MatrixXd::Identity(n, rank);
+    apply(Q, Abasis);
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> small(Q.transpose() * Abasis);
+    Eigen::MatrixXd V = small.eigenvectors().leftCols(k);
+
+    Eigen::MatrixXd Xnew = Q * V;
+    P = Xnew - X * (X.transpose() * Xnew);
+    X = Xnew;
+    AX = Abasis * V;
+  }
+
+  lambda = std::max(0.0, values(TRIVIAL));
+  vector = X.col(TRIVIAL);
+}
+
+}
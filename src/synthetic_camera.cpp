@@ -0,0 +1,96 @@
+#include "synthetic_camera.h"
+
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace rosdrone_Detector
+{
+
+syntheticCamera::syntheticCamera(const sensor_msgs::CameraInfo& info, const RendererOptions& _options)
+  : options(_options), width(info.width), height(info.height), rng(_options.seed)
+{
+  K << info.K[0], info.K[1], info.K[2],
+       info.K[3], info.K[4], info.K[5],
+       info.K[6], info.K[7], info.K[8];
+
+  R << 0, 0, 1,
+      -1, 0, 0,
+       0, -1, 0;
+
+  // sky and ground, then clutter drawn once: it does not move
+  background.create(height, width, CV_8UC3);
+  background(cv::Rect(0, 0, width, height / 2)).setTo(cv::Scalar(200, 170, 140));
+  background(cv::Rect(0, height / 2, width, height - height / 2)).setTo(cv::Scalar(90, 110, 100));
+
+  for(int i = 0; i < options.clutter; i++)
+  {
+    cv::Scalar color(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+    cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+    cv::Size axes(rng.uniform(3, width / 8 + 4), rng.uniform(3, height / 8 + 4));
+    if (i % 2)
+      cv::ellipse(background, center, axes, rng.uniform(0, 180), 0, 360, color, -1, cv::LINE_AA);
+    else
+      cv::rectangle(background, center - cv::Point(axes.width, axes.height), center + cv::Point(axes.width, axes.height), color, -1);
+  }
+}
+
+bool syntheticCamera::project(const Eigen::Vector3d& position, cv::Vec3f& circle) const
+{
+  // inverse of the detector: ball centre in the camera frame
+  Eigen::Vector3d c = R.transpose() * (position + options.t_ball2drone - options.t_camera2drone);
+  if (c.z() < options.ballRadius)
+    return false;
+
+  Eigen::Vector3d p = K * c / c.z();
+  circle = cv::Vec3f(p.x(), p.y(), K(0, 0) * options.ballRadius / c.z());
+  return true;
+}
+
+bool syntheticCamera::visible(const Eigen::Vector3d& position) const
+{
+  cv::Vec3f circle;
+  return project(position, circle) &&
+         circle[0] - circle[2] >= 0 && circle[0] + circle[2] < width &&
+         circle[1] - circle[2] >= 0 && circle[1] + circle[2] < height;
+}
+
+Eigen::Vector3d syntheticCamera::unproject(double u, double v, double z) const
+{
+  Eigen::Vector3d c = z * K.inverse() * Eigen::Vector3d(u, v, 1);
+  return R * c + options.t_camera2drone - options.t_ball2drone;
+}
+
+void syntheticCamera::render(const std::vector<Target>& targets, cv::Mat& bgr)
+{
+  background.copyTo(bgr);
+
+  // farthest first, closer balls hide them
+  order.clear();
+  for(unsigned int k = 0; k < targets.size(); k++)
+    order.push_back({(targets[k].position + options.t_ball2drone - options.t_camera2drone).norm(), k});
+  std::sort(order.rbegin(), order.rend());
+
+  const int shift = 4; // sub-pixel centres and radii
+  for(const auto& o : order)
+  {
+    cv::Vec3f circle;
+    if (!project(targets[o.second].position, circle))
+      continue;
+    cv::Point center(std::round(circle[0] * (1 << shift)), std::round(circle[1] * (1 << shift)));
+    cv::circle(bgr, center, std::round(circle[2] * (1 << shift)), targets[o.second].bgr, -1, cv::LINE_AA, shift);
+  }
+
+  if (options.blur > 0)
+    cv::GaussianBlur(bgr, bgr, cv::Size(), options.blur);
+
+  if (options.noise > 0)
+  {
+    noise.create(bgr.size(), CV_16SC3);
+    rng.fill(noise, cv::RNG::NORMAL, 0, options.noise);
+    bgr.convertTo(image16, CV_16SC3);
+    image16 += noise;
+    image16.convertTo(bgr, CV_8UC3);
+  }
+}
+
+}
@@ -0,0 +1,81 @@
+#include "visibility_graph.h"
+
+#include <cmath>
+
+namespace rosdrone_Detector
+{
+
+visibilityGraph::visibilityGraph(const VisibilityOptions& options) : options(options)
+{
+  tanHorizontal = std::tan(options.fovHorizontal / 2);
+  tanVertical = std::tan(options.fovVertical / 2);
+}
+
+void visibilityGraph::update(const Eigen::Matrix<double, 3, Eigen::Dynamic>& positions,
+                             const Eigen::Matrix<double, 9, Eigen::Dynamic>& rotations)
+{
+  int N = positions.cols();
+  sees.setZero(N, N);
+  count = 0;
+
+  double range_min2 = options.rangeMin * options.rangeMin;
+  double range_max2 = options.rangeMax * options.rangeMax;
+  double radius2 = options.occluderRadius * options.occluderRadius;
+
+  for (int i = 0; i < N; i++)
+  {
+    Eigen::Map<const Eigen::Matrix3d> R(rotations.col(i).data());
+    Eigen::Vector3d center = positions.col(i) + R * options.t_camera2drone;
+    Eigen::Matrix3d R_world2camera = (R * options.R_camera2drone).transpose();
+
+    // every target in the camera frame at once
+    relative = positions.colwise() - center;
+    camera = R_world2camera * relative;
+    squaredRange = relative.colwise().squaredNorm().transpose().array();
+
+    // frustum and range, the camera looks along its z axis
+    auto x = camera.row(0).transpose().array(), y = camera.row(1).transpose().array();
+    auto z = camera.row(2).transpose().array();
+    auto in_view = (z > 0) && (x.abs() <= tanHorizontal * z) && (y.abs() <= tanVertical * z)
+                   && (squaredRange >= range_min2) && (squaredRange <= range_max2);
+    sees.col(i) = in_view.cast<unsigned char>();
+    sees(i, i) = 0;
+
+    int M = sees.col(i).cast<int>().sum();
+    if (M == 0)
+      continue;
+    if (radius2 <= 0)
+    {
+      count += M;
+      continue;
+    }
+
+    // occlusion: projections of every drone on the line of sight of each
+    // candidate, from one product with the gram matrix
+    candidateIndex.resize(M);
+    candidates.resize(3, M);
+    for (int j = 0, m = 0; j < N; j++)
+      if (sees(j, i))
+      {
+        candidateIndex(m) = j;
+        candidates.col(m++) = relative.col(j);
+      }
+    gram.noalias() = relative.transpose() * candidates;
+    squaredNorms = relative.colwise().squaredNorm().transpose().array();
+
+    for (int m = 0; m < M; m++)
+    {
+      int j = candidateIndex(m);
+      double range = std::sqrt(squaredRange(j));
+      along = gram.col(m).array() / range;
+      auto blocks = (along > 0) && (along < range) && (squaredNorms - along.square() < radius2);
+      int blockers = blocks.cast<int>().sum() - (blocks(i) ? 1 : 0) - (blocks(j) ? 1 : 0);
+      if (blockers > 0)
+        sees(j, i) = 0;
+      else
+        count++;
+    }
+  }
+}
+
+}